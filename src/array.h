@@ -0,0 +1,142 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <vector>
+#include <cstddef>
+
+/*! \brief A read-only array of items
+ *
+ *  An array either owns its items or refers to items kept elsewhere, for
+ *  example in an index file mapped to memory. Structures built in memory
+ *  fill a vector and pass it to the array, while structures loaded from an
+ *  index file refer to the mapped file without copying it.
+ */
+template <typename T>
+class Array
+{
+public:
+    /*! \brief Initialize an empty array */
+    Array() : items(NULL), count(0) {}
+
+    /*! \brief Copy an array
+     *
+     *  \param[in]  other   an array to copy
+     */
+    Array(Array const & other) : items(NULL), count(0)
+    {
+        *this = other;
+    }
+
+    /*! \brief Copy an array
+     *
+     *  Owned items are copied, while a reference to external items is copied
+     *  as a reference.
+     *
+     *  \param[in]  other   an array to copy
+     *  \return             the array
+     */
+    Array & operator = (Array const & other)
+    {
+        if (this != &other) {
+            storage = other.storage;
+            items = storage.empty() ? other.items : storage.data();
+            count = other.count;
+        }
+        return *this;
+    }
+
+    /*! \brief Take items of a vector
+     *
+     *  \param[in,out]  source  a vector to take items from, it is left empty
+     */
+    void assign(std::vector <T> & source)
+    {
+        storage.clear();
+        storage.swap(source);
+        items = storage.data();
+        count = storage.size();
+    }
+
+    /*! \brief Refer to items kept elsewhere
+     *
+     *  \param[in]  data    the first item
+     *  \param[in]  size    the number of items
+     */
+    void refer(const T * data, size_t size)
+    {
+        std::vector <T>().swap(storage);
+        items = data;
+        count = size;
+    }
+
+    /*! \brief Get an item
+     *
+     *  \param[in]  i   an item index
+     *  \return         the item
+     */
+    const T & operator [] (size_t i) const
+    {
+        return items[i];
+    }
+
+    /*! \brief Get the first item
+     *
+     *  \return     the pointer to the first item
+     */
+    const T * data() const
+    {
+        return items;
+    }
+
+    /*! \brief Get the first item
+     *
+     *  \return     the pointer to the first item
+     */
+    const T * begin() const
+    {
+        return items;
+    }
+
+    /*! \brief Get the item following the last one
+     *
+     *  \return     the pointer to the item following the last one
+     */
+    const T * end() const
+    {
+        return items + count;
+    }
+
+    /*! \brief Get the number of items
+     *
+     *  \return     the number of items
+     */
+    size_t size() const
+    {
+        return count;
+    }
+
+    /*! \brief Check if the array is empty
+     *
+     *  \return     whether the array has no items
+     */
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    /*! \brief Get the size of the items
+     *
+     *  \return     the number of bytes
+     */
+    size_t memory() const
+    {
+        return count * sizeof(T);
+    }
+
+private:
+    std::vector <T> storage;    //!< owned items
+    const T * items;            //!< the first item
+    size_t count;               //!< the number of items
+};
+
+#endif // ARRAY_H
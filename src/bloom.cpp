@@ -0,0 +1,78 @@
+#include "bloom.h"
+
+#include <algorithm>
+
+const size_t BloomFilter::block_words;
+
+/*! \brief Build the filter from a list of hash values
+ *
+ *  The number of blocks is a power of two giving at least the specified
+ *  number of bits per value.
+ *
+ *  \param[in]  values          hash values
+ *  \param[in]  bits_per_value  the number of filter bits per value; no
+ *                              filter is built if it is 0
+ */
+void BloomFilter::build(std::vector <uint64_t> const & values, size_t bits_per_value)
+{
+    std::vector <uint64_t> blocks;
+    if (bits_per_value && !values.empty()) {
+        size_t count = 1;
+        while (count * block_words * 64 < values.size() * bits_per_value) {
+            count <<= 1;
+        }
+        blocks.resize(count * block_words, 0);
+        for (auto it = values.begin(); it != values.end(); ++it) {
+            uint64_t * block = &blocks[((*it >> 32) & (count - 1)) * block_words];
+            for (size_t i = 0; i < block_words; ++i) {
+                block[i] |= word_bit(*it, i);
+            }
+        }
+    }
+    bits.assign(blocks);
+}
+
+/*! \brief Estimate the false positive rate of the filter
+ *
+ *  A value which was not added to the filter passes it if its bits are set
+ *  in all words of its block, so the rate is estimated from the fraction of
+ *  set bits in each word.
+ *
+ *  \return     the expected fraction of values passing the filter among
+ *              values which were not added to it
+ */
+double BloomFilter::false_positive_rate() const
+{
+    if (empty()) {
+        return 1;
+    }
+    double rate = 0;
+    for (size_t i = 0; i < bits.size(); i += block_words) {
+        double block_rate = 1;
+        for (size_t j = 0; j < block_words; ++j) {
+            block_rate *= __builtin_popcountll(bits[i + j]) / 64.0;
+        }
+        rate += block_rate;
+    }
+    return rate / (bits.size() / block_words);
+}
+
+/*! \brief Get the size of memory allocated for the filter
+ *
+ *  \return     the number of bytes
+ */
+size_t BloomFilter::memory() const
+{
+    return bits.memory();
+}
+
+/*! \brief Check if a filter loaded from an index file is consistent
+ *
+ *  \return     whether the number of blocks is a power of two, as contains()
+ *              requires
+ */
+bool BloomFilter::valid() const
+{
+    size_t blocks = bits.size() / block_words;
+    return empty() || (bits.size() % block_words == 0 && blocks && !(blocks & (blocks - 1)));
+}
@@ -0,0 +1,72 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "array.h"
+
+/*! \brief A cache-blocked Bloom filter of hash values
+ *
+ *  The filter consists of blocks of BloomFilter::block_words 64-bit words,
+ *  which is the size of a cache line. High bits of a hash value select a
+ *  block and low bits select one bit in each word of the block, so a lookup
+ *  touches a single cache line and needs no branches.
+ */
+class BloomFilter
+{
+public:
+    /*! \brief The number of 64-bit words in a block and of bits set per value */
+    static const size_t block_words = 8;
+
+    void build(std::vector <uint64_t> const & values, size_t bits_per_value);
+    double false_positive_rate() const;
+    size_t memory() const;
+    bool valid() const;
+
+    /*! \brief Get the bit of a hash value in a block word
+     *
+     *  \param[in]  value   a hash value
+     *  \param[in]  word    the index of a word in a block
+     *  \return             the mask of the bit in the word
+     */
+    static uint64_t word_bit(uint64_t value, size_t word)
+    {
+        static const uint32_t salts[block_words] = {
+            0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+            0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+        };
+        return (uint64_t)1 << (((uint32_t)value * salts[word]) >> 26);
+    }
+
+    /*! \brief Check if a hash value may have been added to the filter
+     *
+     *  \param[in]  value   a hash value
+     *  \return             false if the value was not added, true if it was
+     *                      added or is a false positive
+     */
+    bool contains(uint64_t value) const
+    {
+        size_t blocks = bits.size() / block_words;
+        const uint64_t * block = &bits[((value >> 32) & (blocks - 1)) * block_words];
+        uint64_t missing = 0;
+        for (size_t i = 0; i < block_words; ++i) {
+            missing |= word_bit(value, i) & ~block[i];
+        }
+        return !missing;
+    }
+
+    /*! \brief Check if the filter is empty
+     *
+     *  \return     whether the filter has no blocks and should not be used
+     */
+    bool empty() const
+    {
+        return bits.empty();
+    }
+
+    Array <uint64_t> bits;  //!< the filter blocks
+};
+
+#endif // BLOOM_H
@@ -0,0 +1,436 @@
+#include "fastq.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const size_t FastqReader::buffer_size;
+
+/*! \brief The number of bytes needed to recognize a compressed file */
+static const size_t gzip_header_size = 18;
+
+/*! \brief The alignment of reader buffers */
+static const size_t buffer_alignment = 4096;
+
+/*! \brief Allocate an aligned buffer
+ *
+ *  \param[in]  size    the buffer size
+ *  \return             the buffer or NULL if it could not be allocated
+ */
+static char * allocate_buffer(size_t size)
+{
+    void * buffer = NULL;
+    if (posix_memalign(&buffer, buffer_alignment, size) != 0) {
+        return NULL;
+    }
+    return (char *)buffer;
+}
+
+/*! \brief Open a FASTQ file
+ *
+ *  Regular uncompressed files are mapped to memory, other files are read
+ *  by blocks.
+ *
+ *  \param[in]  path    the file name
+ *  \param[in]  threads the number of threads decompressing a BGZF file
+ */
+FastqReader::FastqReader(std::string const & path, unsigned int threads) :
+    fd(-1), eof(false), failed(false), buffer(NULL), capacity(buffer_size), begin(0), end(0),
+    is_mapped(false), owner(true)
+{
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        failed = true;
+        return;
+    }
+    if (map()) {
+        return;
+    }
+    buffer = allocate_buffer(capacity);
+    if (!buffer) {
+        failed = true;
+        return;
+    }
+    while (end < gzip_header_size && !eof) {
+        fill();
+    }
+    if (GzipReader::is_gzip(buffer, end)) {
+        gzip.reset(new GzipReader(fd, buffer, end, threads));
+        end = 0;
+        eof = false;
+    }
+}
+
+/*! \brief Create a reader of a part of a mapped file
+ *
+ *  The reader shares the mapping of \p source, which must exist as long as
+ *  the reader is used. Readers of disjoint parts can be used by different
+ *  threads.
+ *
+ *  \param[in]  source  a reader of a mapped file
+ *  \param[in]  first   the start of the part, a record start
+ *  \param[in]  last    the end of the part, a record start or the file end
+ */
+FastqReader::FastqReader(FastqReader const & source, size_t first, size_t last) :
+    fd(-1), eof(true), failed(source.failed), buffer(source.buffer), capacity(source.capacity),
+    begin(first), end(last), is_mapped(source.is_mapped), owner(false)
+{
+}
+
+/*! \brief Close the file and free the buffer */
+FastqReader::~FastqReader()
+{
+    close();
+    if (owner && is_mapped) {
+        munmap(buffer, capacity);
+    } else if (owner) {
+        std::free(buffer);
+    }
+}
+
+/*! \brief Map a regular uncompressed file to memory
+ *
+ *  The kernel is advised to read the file ahead and to use huge pages.
+ *  Pages stay mapped until the reader is destroyed, as records of batches
+ *  still being classified or written refer to them.
+ *
+ *  \return     whether the file was mapped
+ */
+bool FastqReader::map()
+{
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+        return false;
+    }
+    size_t size = info.st_size;
+    void * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    if (GzipReader::is_gzip((const char *)data, size)) {
+        munmap(data, size);
+        return false;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(data, size, MADV_HUGEPAGE);
+#endif
+    buffer = (char *)data;
+    capacity = size;
+    end = size;
+    eof = true;
+    is_mapped = true;
+    return true;
+}
+
+/*! \brief Close the file */
+void FastqReader::close()
+{
+    gzip.reset();
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    eof = true;
+    begin = end;
+}
+
+/*! \brief Read the next block of the file
+ *
+ *  Data not returned as records yet are moved to the beginning of the
+ *  buffer, so records returned before become invalid. The buffer is doubled
+ *  if it is full.
+ */
+void FastqReader::fill()
+{
+    if (begin > 0) {
+        std::memmove(buffer, buffer + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+    if (end == capacity) {
+        char * larger = allocate_buffer(capacity * 2);
+        if (!larger) {
+            failed = true;
+            eof = true;
+            return;
+        }
+        std::memcpy(larger, buffer, end);
+        std::free(buffer);
+        buffer = larger;
+        capacity *= 2;
+    }
+    ssize_t size;
+    if (gzip) {
+        size = gzip->read(buffer + end, capacity - end);
+        failed = failed || gzip->failed();
+    } else {
+        do {
+            size = ::read(fd, buffer + end, capacity - end);
+        } while (size < 0 && errno == EINTR);
+    }
+    if (size <= 0) {
+        failed = failed || size < 0;
+        eof = true;
+        return;
+    }
+    end += size;
+}
+
+/*! \brief Find the end of a line in the buffer
+ *
+ *  \param[in]  data    the buffer
+ *  \param[in]  start   the line start
+ *  \param[in]  end     the end of the data in the buffer
+ *  \return             the position of the line feed or \p end if there is
+ *                      none
+ */
+static inline size_t find_line_end(const char * data, size_t start, size_t end)
+{
+    const void * found = std::memchr(data + start, '\n', end - start);
+    return found ? (const char *)found - data : end;
+}
+
+/*! \brief Take the next record from the buffer
+ *
+ *  At the file end, a record which is cut short is completed with empty
+ *  lines, like reading the file line by line would give.
+ *
+ *  \param[out] record  the record
+ *  \return             whether a record was taken; if not, more data
+ *                      should be read unless the file end was reached
+ */
+bool FastqReader::parse(FastqRecord & record)
+{
+    if (begin == end) {
+        return false;
+    }
+    const char * lines[4];
+    size_t sizes[4];
+    size_t pos = begin;
+    for (size_t i = 0; i < 4; ++i) {
+        size_t line_end = (pos < end) ? find_line_end(buffer, pos, end) : end;
+        if (line_end == end && !eof) {
+            return false;
+        }
+        lines[i] = buffer + pos;
+        sizes[i] = line_end - pos;
+        if (sizes[i] && lines[i][sizes[i] - 1] == '\r') {
+            --sizes[i];
+        }
+        pos = (line_end < end) ? line_end + 1 : end;
+    }
+    record.id = lines[0];
+    record.id_size = sizes[0];
+    record.seq = lines[1];
+    record.seq_size = sizes[1];
+    record.qual = lines[3];
+    record.qual_size = sizes[3];
+    begin = pos;
+    return true;
+}
+
+/*! \brief Read records from the file
+ *
+ *  Records returned by the previous call become invalid. Fewer records than
+ *  requested may be returned if the rest of the buffer does not hold them,
+ *  no records are returned only at the file end.
+ *
+ *  \param[out] records the records referring to the reader buffer
+ *  \param[in]  count   the maximum number of records to read
+ *  \return             the number of records read
+ */
+size_t FastqReader::read(std::vector <FastqRecord> & records, size_t count)
+{
+    records.clear();
+    while (records.size() < count) {
+        FastqRecord record;
+        if (parse(record)) {
+            records.push_back(record);
+        } else if (records.empty() && !eof) {
+            fill();
+        } else {
+            break;
+        }
+    }
+    return records.size();
+}
+
+/*! \brief Return a record and the records following it to the reader
+ *
+ *  \param[in]  record  a record returned by the last call of read(), which
+ *                      will be returned again by the next call
+ */
+void FastqReader::unread(FastqRecord const & record)
+{
+    begin = record.id - buffer;
+}
+
+/*! \brief Find the first record starting at a position or later
+ *
+ *  A line starting with '@' is a record start if the line following the
+ *  next one starts with '+', while a quality line starting with '@' is
+ *  followed by an ID and a sequence line.
+ *
+ *  \param[in]  pos     a position in the buffer
+ *  \return             the record start or the end of the data
+ */
+size_t FastqReader::find_record(size_t pos) const
+{
+    if (pos <= begin) {
+        return begin;
+    }
+    for (size_t line = find_line_end(buffer, pos - 1, end); line < end; ) {
+        size_t start = line + 1;
+        if (start < end && buffer[start] == '@') {
+            size_t id_end = find_line_end(buffer, start, end);
+            size_t seq_end = (id_end < end) ? find_line_end(buffer, id_end + 1, end) : end;
+            if (seq_end + 1 < end && buffer[seq_end + 1] == '+') {
+                return start;
+            }
+        }
+        line = find_line_end(buffer, start, end);
+    }
+    return end;
+}
+
+/*! \brief Split the unread records of a mapped file into parts
+ *
+ *  The parts are of similar size in bytes and start at record starts, so
+ *  they can be read by different threads with readers created by the
+ *  FastqReader(FastqReader const &, size_t, size_t) constructor. The
+ *  records of all parts are written by the writers of the whole file, since
+ *  a tool writes a single output file per input file; writers of parts
+ *  would have to be concatenated afterwards, copying all the output again.
+ *
+ *  \param[in]  parts   the number of parts
+ *  \param[out] ranges  the start and the end of each nonempty part
+ */
+void FastqReader::split(size_t parts, std::vector <std::pair <size_t, size_t> > & ranges) const
+{
+    ranges.clear();
+    size_t start = begin;
+    for (size_t i = 1; i <= parts; ++i) {
+        size_t stop = (i == parts) ? end : std::max(start, find_record(begin + (end - begin) / parts * i));
+        if (stop > start) {
+            ranges.push_back(std::make_pair(start, stop));
+        }
+        start = stop;
+    }
+}
+
+/*! \brief Read paired-end records from two files
+ *
+ *  The same number of records is read from both files; records read from
+ *  the first file beyond those read from the second one are returned to its
+ *  reader.
+ *
+ *  \param[in]  reader1     the reader of first parts of paired-end reads
+ *  \param[in]  reader2     the reader of second parts of paired-end reads
+ *  \param[out] records1    the records of the first parts
+ *  \param[out] records2    the records of the second parts
+ *  \param[in]  count       the maximum number of pairs to read
+ *  \return                 the number of pairs read
+ */
+size_t read_pairs(FastqReader & reader1, FastqReader & reader2,
+                  std::vector <FastqRecord> & records1, std::vector <FastqRecord> & records2,
+                  size_t count)
+{
+    size_t count1 = reader1.read(records1, count);
+    size_t count2 = count1 ? reader2.read(records2, count1) : 0;
+    if (count2 < count1) {
+        reader1.unread(records1[count2]);
+        records1.resize(count2);
+    }
+    return count2;
+}
+
+const size_t FastqWriter::buffer_size;
+
+/*! \brief Create a FASTQ file
+ *
+ *  \param[in]  path        the file name
+ *  \param[in]  level       the compression level from 1 to 9 or 0 to write
+ *                          an uncompressed file
+ *  \param[in]  compressor  the pool compressing the file, which must
+ *                          outlive the writer
+ */
+FastqWriter::FastqWriter(std::string const & path, int level, BgzfPool & compressor) :
+    failed(false)
+{
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd >= 0 && level > 0) {
+        bgzf.reset(new BgzfWriter(fd, level, compressor));
+    } else {
+        buffer.reserve(buffer_size);
+    }
+}
+
+/*! \brief Write the rest of the data and close the file */
+FastqWriter::~FastqWriter()
+{
+    close();
+}
+
+/*! \brief Add data to the file
+ *
+ *  \param[in]  data    the data
+ *  \param[in]  size    the size of the data
+ */
+void FastqWriter::write(const char * data, size_t size)
+{
+    if (bgzf) {
+        bgzf->write(data, size);
+        return;
+    }
+    buffer.append(data, size);
+    if (buffer.size() >= buffer_size) {
+        WriteQueue::shared().write(fd, buffer);
+        buffer.reserve(buffer_size);
+    }
+}
+
+/*! \brief Write the rest of the data and close the file */
+void FastqWriter::close()
+{
+    if (fd < 0) {
+        return;
+    }
+    if (bgzf) {
+        failed = !bgzf->close() || failed;
+        bgzf.reset();
+    } else {
+        WriteQueue & queue = WriteQueue::shared();
+        queue.write(fd, buffer);
+        failed = !queue.flush(fd) || failed;
+    }
+    failed = (::close(fd) != 0) || failed;
+    fd = -1;
+}
+
+/*! \brief Write a record in the FASTQ format
+ *
+ *  \param[in]  fout    a file to write the record to
+ *  \param[in]  record  a record
+ *  \param[in]  type    the read type added to the ID unless the read passed
+ *                      filtration
+ */
+void write_record(FastqWriter & fout, FastqRecord const & record, ReadType type)
+{
+    fout.write(record.id, record.id_size);
+    if (type != ReadType::ok) {
+        std::string const & name = get_type_name(type);
+        fout.write(":", 1);
+        fout.write(name.data(), name.size());
+    }
+    fout.write("\n", 1);
+    fout.write(record.seq, record.seq_size);
+    fout.write("\n+\n", 3);
+    fout.write(record.qual, record.qual_size);
+    fout.write("\n", 1);
+}
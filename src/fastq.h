@@ -0,0 +1,141 @@
+#ifndef FASTQ_H
+#define FASTQ_H
+
+#include <vector>
+#include <utility>
+#include <string>
+#include <memory>
+#include <cstddef>
+
+#include "gzip.h"
+#include "writequeue.h"
+#include "seq.h"
+
+/*! \brief A FASTQ record referring to the buffer of a FastqReader
+ *
+ *  The fields point to the lines of the record in the reader buffer without
+ *  line ends, so they are valid until the next call of FastqReader::read().
+ */
+struct FastqRecord
+{
+    const char * id;    //!< the read ID line including '@'
+    size_t id_size;     //!< the length of the ID line
+    const char * seq;   //!< the read sequence
+    size_t seq_size;    //!< the length of the read sequence
+    const char * qual;  //!< the read quality sequence
+    size_t qual_size;   //!< the length of the quality sequence
+};
+
+/*! \brief A block-buffered reader of FASTQ files
+ *
+ *  The reader fills a large page-aligned buffer with read() calls and finds
+ *  line ends with memchr(), which the C library implements with vector
+ *  instructions. Records are returned as views into the buffer, so reads
+ *  are not copied. A record which does not fit in the rest of the buffer is
+ *  moved to its beginning before the next block is read, and the buffer
+ *  grows if a single record is longer than it. Lines may end with CR LF.
+ *  Gzip-compressed files are recognized by their magic number and
+ *  decompressed by a GzipReader. Regular uncompressed files are mapped to
+ *  memory instead, so records refer to the mapping and nothing is copied;
+ *  the mapping can be split into parts read by several threads.
+ */
+class FastqReader
+{
+public:
+    /*! \brief The initial size of the buffer */
+    static const size_t buffer_size = 1 << 22;
+
+    explicit FastqReader(std::string const & path, unsigned int threads = 1);
+    FastqReader(FastqReader const & source, size_t first, size_t last);
+    ~FastqReader();
+
+    /*! \brief Check if the file was opened
+     *
+     *  \return     whether the file was opened and no read error occurred
+     */
+    bool good() const
+    {
+        return !failed;
+    }
+
+    /*! \brief Check if the file is mapped to memory
+     *
+     *  \return     whether the file is mapped, so it can be split
+     */
+    bool mapped() const
+    {
+        return is_mapped;
+    }
+
+    void close();
+    size_t read(std::vector <FastqRecord> & records, size_t count);
+    void unread(FastqRecord const & record);
+    void split(size_t parts, std::vector <std::pair <size_t, size_t> > & ranges) const;
+
+private:
+    FastqReader(FastqReader const &) = delete;
+    FastqReader & operator = (FastqReader const &) = delete;
+
+    bool map();
+    bool parse(FastqRecord & record);
+    void fill();
+    size_t find_record(size_t pos) const;
+
+    int fd;             //!< the file descriptor or -1 if the file is closed
+    std::unique_ptr <GzipReader> gzip;  //!< the decompressor of a compressed file
+    bool eof;           //!< whether the file end was reached
+    bool failed;        //!< whether a read error occurred
+    char * buffer;      //!< the buffer
+    size_t capacity;    //!< the size of the buffer
+    size_t begin;       //!< the position of the first record not returned yet
+    size_t end;         //!< the end of the data in the buffer
+    bool is_mapped;     //!< whether the buffer is a mapping of the whole file
+    bool owner;         //!< whether the buffer belongs to the reader
+};
+
+/*! \brief A writer of FASTQ files
+ *
+ *  Records are collected in a buffer which is handed over to the shared
+ *  WriteQueue when it is full, so the caller goes on with an empty buffer
+ *  while the full one is written. If a compression level is given, the
+ *  records are compressed to the BGZF format by a BgzfWriter instead, on
+ *  the threads of a pool shared by the files written at once.
+ */
+class FastqWriter
+{
+public:
+    /*! \brief The size of buffers of uncompressed files */
+    static const size_t buffer_size = 1 << 20;
+
+    FastqWriter(std::string const & path, int level, BgzfPool & compressor);
+    ~FastqWriter();
+
+    /*! \brief Check if the file was opened
+     *
+     *  \return     whether the file is open and no write error occurred
+     */
+    bool good() const
+    {
+        return fd >= 0 && !failed;
+    }
+
+    void write(const char * data, size_t size);
+    void close();
+
+private:
+    FastqWriter(FastqWriter const &) = delete;
+    FastqWriter & operator = (FastqWriter const &) = delete;
+
+    int fd;             //!< the file descriptor or -1 if the file is closed
+    bool failed;        //!< whether a write error occurred
+    std::string buffer; //!< data not handed over to the write queue yet
+    std::unique_ptr <BgzfWriter> bgzf;  //!< the compressor of a compressed file
+};
+
+size_t read_pairs(FastqReader & reader1, FastqReader & reader2,
+                  std::vector <FastqRecord> & records1, std::vector <FastqRecord> & records2,
+                  size_t count);
+void write_record(FastqWriter & fout, FastqRecord const & record,
+                  ReadType type = ReadType::ok);
+
+#endif // FASTQ_H
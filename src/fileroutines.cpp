@@ -1,9 +1,15 @@
 #include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <set>
 #include <dirent.h>
 #include <sys/stat.h>
 #include "fileroutines.h"
 
 /*! \brief Get a filename from a path
+ *
+ *  The extension is removed from the filename, and the .gz extension of
+ *  compressed files is removed together with the one preceding it.
  *
  *  \param[in]  path    a file path
  *  \return             a filename from the specified path
@@ -15,6 +21,10 @@ std::string basename(std::string const & path)
     if (pos != std::string::npos) {
         res.erase(0, pos);
     }
+    static const std::string gz = ".gz";
+    if (res.size() > gz.size() && res.compare(res.size() - gz.size(), gz.size(), gz) == 0) {
+        res = remove_extension(res);
+    }
     res = remove_extension(res);
     return res;
 }
@@ -43,3 +53,84 @@ bool verify_directory(const std::string & dirname) {
     }
     return true;
 }
+
+/*! \brief Read a manifest of samples
+ *
+ *  Each line of the manifest lists the files of a sample: a file of
+ *  single-end reads or two files of paired-end reads separated by
+ *  whitespace. Empty lines and lines starting with '#' are skipped.
+ *
+ *  \param[in]  path        the manifest file
+ *  \param[out] samples     the samples listed in the manifest
+ *  \return                 \p true if the manifest was read, \p false if it
+ *                          cannot be opened or has a line of another format
+ */
+bool read_manifest(std::string const & path, std::vector <Sample> & samples)
+{
+    std::ifstream manifest_f(path.c_str());
+    if (!manifest_f.good()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(manifest_f, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        std::istringstream fields(line);
+        std::vector <std::string> files;
+        std::string file;
+        while (fields >> file) {
+            files.push_back(file);
+        }
+        if (files.empty() || files[0][0] == '#') {
+            continue;
+        }
+        Sample sample;
+        if (files.size() == 1) {
+            sample.reads = files[0];
+        } else if (files.size() == 2) {
+            sample.reads1 = files[0];
+            sample.reads2 = files[1];
+        } else {
+            return false;
+        }
+        samples.push_back(sample);
+    }
+    return true;
+}
+
+/*! \brief Check that files of samples have distinct names
+ *
+ *  Output files are named after input files, so samples processed together
+ *  must not have files of the same name in different directories.
+ *
+ *  \param[in]  samples     the samples
+ *  \return                 \p true if all files of the samples have distinct names
+ */
+bool distinct_names(std::vector <Sample> const & samples)
+{
+    std::set <std::string> names;
+    for (auto it = samples.begin(); it != samples.end(); ++it) {
+        std::string const * files[] = {&it->reads, &it->reads1, &it->reads2};
+        for (size_t i = 0; i < 3; ++i) {
+            if (!files[i]->empty() && !names.insert(basename(*files[i])).second) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*! \brief Get the size of a file
+ *
+ *  \param[in]  path    a file path
+ *  \return             the size of the file in bytes, 0 if it is unknown
+ */
+size_t file_size(std::string const & path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return 0;
+    }
+    return info.st_size;
+}
@@ -2,9 +2,26 @@
 #define FILEROUTINES_H
 
 #include <string>
+#include <vector>
+#include <cstddef>
+
+/*! \brief Input files of a sample
+ *
+ *  A sample has either a file of single-end reads or a pair of files of
+ *  paired-end reads.
+ */
+struct Sample
+{
+    std::string reads;      //!< the file of single-end reads
+    std::string reads1;     //!< the file of first parts of paired-end reads
+    std::string reads2;     //!< the file of second parts of paired-end reads
+};
 
 std::string basename(std::string const & path);
 std::string remove_extension(const std::string & filename);
 bool verify_directory(const std::string & dirname);
+bool read_manifest(std::string const & path, std::vector <Sample> & samples);
+bool distinct_names(std::vector <Sample> const & samples);
+size_t file_size(std::string const & path);
 
 #endif // FILEROUTINES_H
@@ -0,0 +1,686 @@
+#include "gzip.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <zlib.h>
+
+const size_t GzipReader::chunk_blocks;
+const size_t GzipReader::chunk_size;
+
+/*! \brief The size of a BGZF block header */
+static const size_t bgzf_header_size = 18;
+/*! \brief The size of a gzip member footer (CRC32 and ISIZE) */
+static const size_t gzip_footer_size = 8;
+/*! \brief The maximum size of a BGZF block, compressed or not */
+static const size_t bgzf_max_block_size = 1 << 16;
+/*! \brief The maximum ratio of inflated to deflated data sizes */
+static const size_t deflate_max_ratio = 1032;
+
+/*! \brief Read a little-endian 16-bit number
+ *
+ *  \param[in]  data    the first byte of the number
+ *  \return             the number
+ */
+static inline size_t read_le16(const char * data)
+{
+    const unsigned char * bytes = (const unsigned char *)data;
+    return bytes[0] | (bytes[1] << 8);
+}
+
+/*! \brief Read a little-endian 32-bit number
+ *
+ *  \param[in]  data    the first byte of the number
+ *  \return             the number
+ */
+static inline unsigned long read_le32(const char * data)
+{
+    const unsigned char * bytes = (const unsigned char *)data;
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned long)bytes[3] << 24);
+}
+
+/*! \brief Check if data start with the gzip magic number
+ *
+ *  \param[in]  data    the beginning of a file
+ *  \param[in]  size    the number of bytes available
+ *  \return             whether the file is gzip-compressed
+ */
+bool GzipReader::is_gzip(const char * data, size_t size)
+{
+    return size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+}
+
+/*! \brief Check if data start with a BGZF block header
+ *
+ *  \param[in]  data    the beginning of a gzip member
+ *  \param[in]  size    the number of bytes available
+ *  \return             whether the member is a BGZF block
+ */
+bool GzipReader::is_bgzf(const char * data, size_t size)
+{
+    return size >= bgzf_header_size && is_gzip(data, size) && data[2] == 8 && (data[3] & 4) &&
+           read_le16(data + 10) == 6 && data[12] == 'B' && data[13] == 'C' && read_le16(data + 14) == 2;
+}
+
+/*! \brief Start decompressing a file
+ *
+ *  \param[in]  fd          the file descriptor, which must stay open while
+ *                          the reader exists
+ *  \param[in]  prefix      data already read from the file
+ *  \param[in]  prefix_size the size of \p prefix
+ *  \param[in]  threads     the number of threads inflating BGZF blocks
+ */
+GzipReader::GzipReader(int fd, const char * prefix, size_t prefix_size, unsigned int threads) :
+    fd(fd), prefix(prefix, prefix + prefix_size), prefix_pos(0), current(NULL), current_pos(0),
+    finished(false), stopped(false), read_failed(false), broken(false), error(false)
+{
+    threads = std::max(threads, 1u);
+    bool blocked = is_bgzf(prefix, prefix_size);
+    size_t chunks = blocked ? 2 * threads + 2 : 3;
+    for (size_t i = 0; i < chunks; ++i) {
+        pool.push_back(std::unique_ptr <Chunk> (new Chunk));
+        free_chunks.push_back(pool.back().get());
+    }
+    if (blocked) {
+        this->threads.push_back(std::thread(&GzipReader::read_blocks, this));
+        for (unsigned int i = 0; i < threads; ++i) {
+            this->threads.push_back(std::thread(&GzipReader::inflate_blocks, this));
+        }
+    } else {
+        this->threads.push_back(std::thread(&GzipReader::inflate_stream, this));
+    }
+}
+
+/*! \brief Stop decompression */
+GzipReader::~GzipReader()
+{
+    {
+        std::lock_guard <std::mutex> lock(mutex);
+        stopped = true;
+    }
+    space.notify_all();
+    work.notify_all();
+    ready.notify_all();
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+}
+
+/*! \brief Read compressed data
+ *
+ *  \param[out] data    a buffer
+ *  \param[in]  size    the number of bytes to read
+ *  \return             the number of bytes read, which is less than \p size
+ *                      only at the file end or if an error occurred
+ */
+size_t GzipReader::read_raw(char * data, size_t size)
+{
+    size_t total = std::min(size, prefix.size() - prefix_pos);
+    std::memcpy(data, prefix.data() + prefix_pos, total);
+    prefix_pos += total;
+    while (total < size) {
+        ssize_t count = ::read(fd, data + total, size - total);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            read_failed = count < 0;
+            break;
+        }
+        total += count;
+    }
+    return total;
+}
+
+/*! \brief Take a free chunk and put it at the end of the chunk queue
+ *
+ *  \return     the chunk or NULL if the reader is being destroyed
+ */
+GzipReader::Chunk * GzipReader::acquire()
+{
+    std::unique_lock <std::mutex> lock(mutex);
+    space.wait(lock, [this] { return stopped || !free_chunks.empty(); });
+    if (stopped) {
+        return NULL;
+    }
+    Chunk * chunk = free_chunks.back();
+    free_chunks.pop_back();
+    chunk->done = false;
+    chunk->failed = false;
+    ordered.push_back(chunk);
+    return chunk;
+}
+
+/*! \brief Pass a chunk on
+ *
+ *  \param[in]  chunk       a chunk taken by acquire()
+ *  \param[in]  inflated    whether the chunk is ready for the caller or
+ *                          should be inflated first
+ */
+void GzipReader::publish(Chunk * chunk, bool inflated)
+{
+    std::lock_guard <std::mutex> lock(mutex);
+    if (inflated) {
+        chunk->done = true;
+        ready.notify_all();
+    } else {
+        pending.push_back(chunk);
+        work.notify_one();
+    }
+}
+
+/*! \brief Mark the whole file as split into chunks
+ *
+ *  \param[in]  failed  whether the file could not be read to the end
+ */
+void GzipReader::finish(bool failed)
+{
+    std::lock_guard <std::mutex> lock(mutex);
+    finished = true;
+    broken = failed;
+    work.notify_all();
+    ready.notify_all();
+}
+
+/*! \brief Split a BGZF file into chunks of blocks
+ *
+ *  The blocks are only read here and inflated by inflate_blocks().
+ */
+void GzipReader::read_blocks()
+{
+    bool failed = false;
+    bool end = false;
+    while (!failed && !end) {
+        Chunk * chunk = acquire();
+        if (!chunk) {
+            return;
+        }
+        std::vector <char> & raw = chunk->raw;
+        raw.clear();
+        chunk->offsets.assign(1, 0);
+        while (chunk->offsets.size() <= chunk_blocks) {
+            size_t start = raw.size();
+            raw.resize(start + bgzf_header_size);
+            size_t size = read_raw(&raw[start], bgzf_header_size);
+            if (size == 0) {
+                raw.resize(start);
+                end = true;
+                break;
+            }
+            size_t block_size = read_le16(&raw[start + 16]) + 1;
+            if (!is_bgzf(&raw[start], size) || block_size < bgzf_header_size + gzip_footer_size) {
+                raw.resize(start);
+                failed = true;
+                break;
+            }
+            raw.resize(start + block_size);
+            size = block_size - bgzf_header_size;
+            if (read_raw(&raw[start + bgzf_header_size], size) < size) {
+                raw.resize(start);
+                failed = true;
+                break;
+            }
+            chunk->offsets.push_back(raw.size());
+        }
+        if (chunk->offsets.size() > 1) {
+            publish(chunk, false);
+        } else {
+            chunk->data.clear();
+            publish(chunk, true);
+        }
+    }
+    finish(failed || read_failed);
+}
+
+/*! \brief Inflate chunks of BGZF blocks queued by read_blocks()
+ *
+ *  The function is run by each thread of the pool. A chunk fails if the
+ *  inflated size of a block exceeds the BGZF block size or cannot be
+ *  inflated from the deflated size of the block.
+ */
+void GzipReader::inflate_blocks()
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    bool initialized = inflateInit2(&stream, -MAX_WBITS) == Z_OK;
+    for (;;) {
+        Chunk * chunk;
+        {
+            std::unique_lock <std::mutex> lock(mutex);
+            work.wait(lock, [this] { return stopped || finished || !pending.empty(); });
+            if (stopped || pending.empty()) {
+                break;
+            }
+            chunk = pending.front();
+            pending.pop_front();
+        }
+        std::vector <char> const & raw = chunk->raw;
+        std::vector <size_t> const & offsets = chunk->offsets;
+        size_t total = 0;
+        bool valid = initialized;
+        for (size_t i = 1; i < offsets.size() && valid; ++i) {
+            size_t size = read_le32(&raw[offsets[i] - 4]);
+            size_t deflated = offsets[i] - offsets[i - 1] - bgzf_header_size - gzip_footer_size;
+            valid = size <= bgzf_max_block_size && size <= deflated * deflate_max_ratio;
+            total += size;
+        }
+        chunk->data.resize(valid ? total : 0);
+        chunk->failed = !valid;
+        char * out = chunk->data.data();
+        for (size_t i = 1; i < offsets.size() && !chunk->failed; ++i) {
+            const char * block = &raw[offsets[i - 1]];
+            const char * footer = &raw[offsets[i] - gzip_footer_size];
+            size_t size = read_le32(footer + 4);
+            inflateReset(&stream);
+            stream.next_in = (Bytef *)(block + bgzf_header_size);
+            stream.avail_in = footer - block - bgzf_header_size;
+            stream.next_out = (Bytef *)out;
+            stream.avail_out = size;
+            int result = inflate(&stream, Z_FINISH);
+            chunk->failed = (result != Z_STREAM_END || stream.avail_out != 0 ||
+                             crc32(crc32(0L, Z_NULL, 0), (const Bytef *)out, size) != read_le32(footer));
+            out += size;
+        }
+        publish(chunk, true);
+    }
+    if (initialized) {
+        inflateEnd(&stream);
+    }
+}
+
+/*! \brief Inflate a gzip file which is not split into BGZF blocks
+ *
+ *  Concatenated gzip members are inflated one after another, and data
+ *  following the last member which are not a gzip member are ignored like
+ *  gzip does.
+ */
+void GzipReader::inflate_stream()
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    bool failed = inflateInit2(&stream, MAX_WBITS + 16) != Z_OK;
+    bool end = false;
+    bool member_done = false;
+    std::vector <char> input(chunk_size);
+    while (!failed && !end) {
+        Chunk * chunk = acquire();
+        if (!chunk) {
+            break;
+        }
+        chunk->data.resize(chunk_size);
+        stream.next_out = (Bytef *)chunk->data.data();
+        stream.avail_out = chunk_size;
+        while (stream.avail_out > 0) {
+            if (stream.avail_in == 0) {
+                size_t size = read_raw(input.data(), input.size());
+                if (size == 0) {
+                    failed = !member_done;
+                    end = true;
+                    break;
+                }
+                stream.next_in = (Bytef *)input.data();
+                stream.avail_in = size;
+            }
+            int result = inflate(&stream, Z_NO_FLUSH);
+            if (result == Z_STREAM_END) {
+                member_done = true;
+                inflateReset(&stream);
+            } else if (result == Z_OK || result == Z_BUF_ERROR) {
+                member_done = false;
+            } else {
+                failed = !(member_done && result == Z_DATA_ERROR);
+                end = true;
+                break;
+            }
+        }
+        chunk->data.resize(chunk_size - stream.avail_out);
+        publish(chunk, true);
+    }
+    inflateEnd(&stream);
+    finish(failed || read_failed);
+}
+
+/*! \brief Take the next decompressed chunk
+ *
+ *  The chunk read before is freed.
+ *
+ *  \return     the chunk or NULL at the file end or if an error occurred
+ */
+GzipReader::Chunk * GzipReader::next_chunk()
+{
+    std::unique_lock <std::mutex> lock(mutex);
+    if (current) {
+        free_chunks.push_back(current);
+        current = NULL;
+        space.notify_one();
+    }
+    while (!error) {
+        ready.wait(lock, [this] {
+            return ordered.empty() ? finished : ordered.front()->done;
+        });
+        if (ordered.empty()) {
+            error = broken;
+            break;
+        }
+        Chunk * chunk = ordered.front();
+        ordered.pop_front();
+        if (!chunk->failed && !chunk->data.empty()) {
+            return chunk;
+        }
+        error = chunk->failed;
+        free_chunks.push_back(chunk);
+        space.notify_one();
+    }
+    return NULL;
+}
+
+/*! \brief Read decompressed data
+ *
+ *  \param[out] data    a buffer
+ *  \param[in]  size    the size of the buffer
+ *  \return             the number of bytes read; 0 only at the file end or
+ *                      if an error occurred (see failed())
+ */
+size_t GzipReader::read(char * data, size_t size)
+{
+    size_t total = 0;
+    while (total < size) {
+        if (!current || current_pos == current->data.size()) {
+            if (total > 0) {
+                break;
+            }
+            current = next_chunk();
+            current_pos = 0;
+            if (!current) {
+                break;
+            }
+        }
+        size_t count = std::min(size - total, current->data.size() - current_pos);
+        std::memcpy(data + total, current->data.data() + current_pos, count);
+        current_pos += count;
+        total += count;
+    }
+    return total;
+}
+
+const size_t BgzfWriter::block_size;
+const size_t BgzfWriter::job_blocks;
+
+/*! \brief The empty block marking the end of a BGZF file */
+static const char bgzf_eof[] = "\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00"
+                               "\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+
+/*! \brief Write a little-endian 16-bit number
+ *
+ *  \param[out] data    the first byte of the number
+ *  \param[in]  value   the number
+ */
+static inline void write_le16(char * data, size_t value)
+{
+    data[0] = value & 0xff;
+    data[1] = (value >> 8) & 0xff;
+}
+
+/*! \brief Write a little-endian 32-bit number
+ *
+ *  \param[out] data    the first byte of the number
+ *  \param[in]  value   the number
+ */
+static inline void write_le32(char * data, unsigned long value)
+{
+    write_le16(data, value & 0xffff);
+    write_le16(data + 2, (value >> 16) & 0xffff);
+}
+
+/*! \brief Start a BGZF file
+ *
+ *  \param[in]  fd          the file descriptor, which must stay open until
+ *                          close() is called
+ *  \param[in]  level       the compression level from 1 to 9
+ *  \param[in]  compressor  the pool compressing the data
+ */
+BgzfWriter::BgzfWriter(int fd, int level, BgzfPool & compressor) :
+    fd(fd), level(level), compressor(compressor), max_jobs(compressor.limit() + 2),
+    current(NULL), finished(false), failed(false)
+{
+    thread = std::thread(&BgzfWriter::write_jobs, this);
+    current = acquire();
+}
+
+/*! \brief Finish the file unless close() was called */
+BgzfWriter::~BgzfWriter()
+{
+    close();
+}
+
+/*! \brief Take a free job and put it at the end of the job queue
+ *
+ *  A new job is allocated if none is free and the limit is not reached.
+ *
+ *  \return     the job
+ */
+BgzfWriter::Job * BgzfWriter::acquire()
+{
+    std::unique_lock <std::mutex> lock(mutex);
+    if (free_jobs.empty() && pool.size() < max_jobs) {
+        pool.push_back(std::unique_ptr <Job> (new Job));
+        free_jobs.push_back(pool.back().get());
+    }
+    space.wait(lock, [this] { return !free_jobs.empty(); });
+    Job * job = free_jobs.back();
+    free_jobs.pop_back();
+    job->data.clear();
+    job->done = false;
+    ordered.push_back(job);
+    return job;
+}
+
+/*! \brief Queue the current job for compression */
+void BgzfWriter::submit()
+{
+    compressor.submit(this, current);
+    current = NULL;
+}
+
+/*! \brief Add data to the file
+ *
+ *  \param[in]  data    the data
+ *  \param[in]  size    the size of the data
+ */
+void BgzfWriter::write(const char * data, size_t size)
+{
+    const size_t limit = block_size * job_blocks;
+    while (size > 0) {
+        size_t count = std::min(size, limit - current->data.size());
+        current->data.insert(current->data.end(), data, data + count);
+        data += count;
+        size -= count;
+        if (current->data.size() == limit) {
+            submit();
+            current = acquire();
+        }
+    }
+}
+
+/*! \brief Compress a job queued by write() into BGZF blocks
+ *
+ *  The function is run by a thread of the pool.
+ *
+ *  \param[in,out]  job     the job
+ *  \param[in,out]  stream  the deflate stream of the compression level of
+ *                          the writer or NULL if it cannot be initialized
+ */
+void BgzfWriter::compress(Job * job, z_stream * stream)
+{
+    std::vector <char> const & data = job->data;
+    std::vector <char> & compressed = job->compressed;
+    compressed.resize((data.size() + block_size - 1) / block_size * bgzf_max_block_size);
+    bool success = stream != NULL;
+    size_t size = 0;
+    for (size_t start = 0; start < data.size() && success; start += block_size) {
+        size_t count = std::min(block_size, data.size() - start);
+        char * block = &compressed[size];
+        deflateReset(stream);
+        stream->next_in = (Bytef *)&data[start];
+        stream->avail_in = count;
+        stream->next_out = (Bytef *)(block + bgzf_header_size);
+        stream->avail_out = bgzf_max_block_size - bgzf_header_size - gzip_footer_size;
+        success = deflate(stream, Z_FINISH) == Z_STREAM_END;
+        size_t length = bgzf_header_size + stream->total_out + gzip_footer_size;
+        std::memcpy(block, bgzf_eof, bgzf_header_size);
+        write_le16(block + 16, length - 1);
+        char * footer = block + length - gzip_footer_size;
+        write_le32(footer, crc32(crc32(0L, Z_NULL, 0), (const Bytef *)&data[start], count));
+        write_le32(footer + 4, count);
+        size += length;
+    }
+    compressed.resize(success ? size : 0);
+    std::lock_guard <std::mutex> lock(mutex);
+    failed = failed || !success;
+    job->done = true;
+    ready.notify_all();
+}
+
+/*! \brief Write data to the file
+ *
+ *  \param[in]  data    the data
+ *  \param[in]  size    the size of the data
+ *  \return             whether the data were written
+ */
+bool BgzfWriter::write_raw(const char * data, size_t size)
+{
+    while (size > 0) {
+        ssize_t count = ::write(fd, data, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= count;
+    }
+    return true;
+}
+
+/*! \brief Write compressed jobs in the file order */
+void BgzfWriter::write_jobs()
+{
+    std::unique_lock <std::mutex> lock(mutex);
+    for (;;) {
+        ready.wait(lock, [this] {
+            return ordered.empty() ? finished : ordered.front()->done;
+        });
+        if (ordered.empty()) {
+            break;
+        }
+        Job * job = ordered.front();
+        ordered.pop_front();
+        bool skip = failed;
+        lock.unlock();
+        bool success = skip || write_raw(job->compressed.data(), job->compressed.size());
+        lock.lock();
+        failed = failed || !success;
+        free_jobs.push_back(job);
+        space.notify_one();
+    }
+}
+
+/*! \brief Compress and write the remaining data and the end-of-file block
+ *
+ *  \return     whether all data were written
+ */
+bool BgzfWriter::close()
+{
+    if (!thread.joinable()) {
+        return !failed;
+    }
+    submit();
+    {
+        std::lock_guard <std::mutex> lock(mutex);
+        finished = true;
+    }
+    ready.notify_all();
+    thread.join();
+    if (!failed) {
+        failed = !write_raw(bgzf_eof, sizeof(bgzf_eof) - 1);
+    }
+    return !failed;
+}
+
+/*! \brief Create a pool of compressing threads
+ *
+ *  \param[in]  threads the maximum number of threads
+ */
+BgzfPool::BgzfPool(unsigned int threads) : max_threads(std::max(threads, 1u)), stopped(false)
+{
+}
+
+/*! \brief Compress the queued jobs and stop the threads */
+BgzfPool::~BgzfPool()
+{
+    {
+        std::lock_guard <std::mutex> lock(mutex);
+        stopped = true;
+    }
+    work.notify_all();
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+}
+
+/*! \brief Queue a job for compression
+ *
+ *  A thread is started if the pool has fewer threads than its limit.
+ *
+ *  \param[in]  writer  the writer of the job
+ *  \param[in]  job     the job
+ */
+void BgzfPool::submit(BgzfWriter * writer, BgzfWriter::Job * job)
+{
+    std::lock_guard <std::mutex> lock(mutex);
+    Task task = {writer, job};
+    pending.push_back(task);
+    if (threads.size() < max_threads) {
+        threads.push_back(std::thread(&BgzfPool::run, this));
+    }
+    work.notify_one();
+}
+
+/*! \brief Compress queued jobs until the pool is destroyed
+ *
+ *  The function is run by each thread of the pool, which keeps a deflate
+ *  stream for each compression level it has used.
+ */
+void BgzfPool::run()
+{
+    z_stream streams[Z_BEST_COMPRESSION + 1];
+    bool initialized[Z_BEST_COMPRESSION + 1] = {};
+    bool usable[Z_BEST_COMPRESSION + 1] = {};
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock <std::mutex> lock(mutex);
+            work.wait(lock, [this] { return stopped || !pending.empty(); });
+            if (pending.empty()) {
+                break;
+            }
+            task = pending.front();
+            pending.pop_front();
+        }
+        int level = task.writer->level;
+        if (!initialized[level]) {
+            std::memset(&streams[level], 0, sizeof(streams[level]));
+            usable[level] = deflateInit2(&streams[level], level, Z_DEFLATED, -MAX_WBITS, 8,
+                                         Z_DEFAULT_STRATEGY) == Z_OK;
+            initialized[level] = true;
+        }
+        task.writer->compress(task.job, usable[level] ? &streams[level] : NULL);
+    }
+    for (int level = 0; level <= Z_BEST_COMPRESSION; ++level) {
+        if (usable[level]) {
+            deflateEnd(&streams[level]);
+        }
+    }
+}
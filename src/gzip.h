@@ -0,0 +1,196 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+/*! \brief A reader of gzip-compressed files decompressing ahead of the caller
+ *
+ *  Files in the BGZF format (blocked gzip written by bgzip and htslib) are
+ *  split into independent blocks, so a reading thread collects the raw
+ *  blocks into chunks and a pool of threads inflates the chunks in
+ *  parallel. Other gzip files, including concatenated ones, are inflated
+ *  by a single dedicated thread. In both cases the decompressed chunks are
+ *  returned in the file order.
+ */
+class GzipReader
+{
+public:
+    /*! \brief The number of BGZF blocks inflated together */
+    static const size_t chunk_blocks = 64;
+    /*! \brief The size of decompressed chunks of plain gzip files */
+    static const size_t chunk_size = 1 << 22;
+
+    GzipReader(int fd, const char * prefix, size_t prefix_size, unsigned int threads);
+    ~GzipReader();
+
+    static bool is_gzip(const char * data, size_t size);
+    static bool is_bgzf(const char * data, size_t size);
+
+    size_t read(char * data, size_t size);
+
+    /*! \brief Check if the file could not be read or decompressed
+     *
+     *  \return     whether an error occurred
+     */
+    bool failed() const
+    {
+        return error;
+    }
+
+private:
+    /*! \brief A piece of the file decompressed as a whole */
+    struct Chunk
+    {
+        std::vector <char> raw;         //!< compressed BGZF blocks
+        std::vector <size_t> offsets;   //!< the start of each block in Chunk::raw and its end
+        std::vector <char> data;        //!< the decompressed data
+        bool done;                      //!< whether the data are ready
+        bool failed;                    //!< whether the data could not be decompressed
+    };
+
+    GzipReader(GzipReader const &) = delete;
+    GzipReader & operator = (GzipReader const &) = delete;
+
+    size_t read_raw(char * data, size_t size);
+    Chunk * acquire();
+    void publish(Chunk * chunk, bool inflated);
+    void finish(bool failed);
+    void read_blocks();
+    void inflate_blocks();
+    void inflate_stream();
+    Chunk * next_chunk();
+
+    int fd;                                     //!< the file descriptor
+    std::vector <char> prefix;                  //!< data read from the file before it was passed over
+    size_t prefix_pos;                          //!< the position of unread data in GzipReader::prefix
+    std::vector <std::unique_ptr <Chunk> > pool;//!< all chunks
+    std::vector <Chunk *> free_chunks;          //!< chunks not in use
+    std::deque <Chunk *> ordered;               //!< chunks being decompressed or ready, in the file order
+    std::deque <Chunk *> pending;               //!< chunks waiting for a thread to inflate them
+    Chunk * current;                            //!< the chunk the caller reads from
+    size_t current_pos;                         //!< the position of unread data in the current chunk
+    bool finished;                              //!< whether the whole file was split into chunks
+    bool stopped;                               //!< whether the threads should quit
+    bool read_failed;                           //!< whether reading the file failed
+    bool broken;                                //!< whether the file could not be split into chunks
+    bool error;                                 //!< whether an error occurred before the data returned
+    std::mutex mutex;                           //!< the lock of the chunk queues
+    std::condition_variable space;              //!< notified when a chunk is freed
+    std::condition_variable work;               //!< notified when a chunk is waiting to be inflated
+    std::condition_variable ready;              //!< notified when a chunk is decompressed
+    std::vector <std::thread> threads;          //!< the reading and inflating threads
+};
+
+class BgzfPool;
+
+/*! \brief A writer of BGZF files compressing on a pool of threads
+ *
+ *  Data are collected into jobs of up to BgzfWriter::job_blocks blocks,
+ *  which are compressed in parallel by the threads of a BgzfPool, and a
+ *  writing thread writes the compressed jobs in order. Jobs are allocated
+ *  as they are needed, up to two more than the threads of the pool. The
+ *  output can be read by gzip and by tools reading BGZF files.
+ */
+class BgzfWriter
+{
+public:
+    /*! \brief The maximum size of data in a block, as bgzip uses */
+    static const size_t block_size = 0xff00;
+    /*! \brief The number of blocks compressed together */
+    static const size_t job_blocks = 64;
+
+    BgzfWriter(int fd, int level, BgzfPool & compressor);
+    ~BgzfWriter();
+
+    void write(const char * data, size_t size);
+    bool close();
+
+private:
+    friend class BgzfPool;
+
+    /*! \brief Data compressed as a whole */
+    struct Job
+    {
+        std::vector <char> data;        //!< the data to compress
+        std::vector <char> compressed;  //!< the compressed BGZF blocks
+        bool done;                      //!< whether the data were compressed
+    };
+
+    BgzfWriter(BgzfWriter const &) = delete;
+    BgzfWriter & operator = (BgzfWriter const &) = delete;
+
+    Job * acquire();
+    void submit();
+    void compress(Job * job, struct z_stream_s * stream);
+    void write_jobs();
+    bool write_raw(const char * data, size_t size);
+
+    int fd;                                     //!< the file descriptor
+    int level;                                  //!< the compression level
+    BgzfPool & compressor;                      //!< the pool compressing the jobs
+    size_t max_jobs;                            //!< the maximum number of jobs
+    std::vector <std::unique_ptr <Job> > pool;  //!< all jobs
+    std::vector <Job *> free_jobs;              //!< jobs not in use
+    std::deque <Job *> ordered;                 //!< jobs being compressed or written, in the file order
+    Job * current;                              //!< the job collecting data
+    bool finished;                              //!< whether all data were submitted
+    bool failed;                                //!< whether an error occurred
+    std::mutex mutex;                           //!< the lock of the job queues
+    std::condition_variable space;              //!< notified when a job is freed
+    std::condition_variable ready;              //!< notified when a job is compressed
+    std::thread thread;                         //!< the writing thread
+};
+
+/*! \brief A pool of threads compressing the jobs of BGZF writers
+ *
+ *  All files written at once share a pool, so the number of compressing
+ *  threads does not grow with the number of files. Threads are started as
+ *  jobs arrive, up to the limit given to the constructor. The pool must
+ *  outlive its writers.
+ */
+class BgzfPool
+{
+public:
+    explicit BgzfPool(unsigned int threads);
+    ~BgzfPool();
+
+    /*! \brief Get the maximum number of compressing threads
+     *
+     *  \return     the number of threads
+     */
+    unsigned int limit() const
+    {
+        return max_threads;
+    }
+
+private:
+    friend class BgzfWriter;
+
+    /*! \brief A job waiting to be compressed */
+    struct Task
+    {
+        BgzfWriter * writer;    //!< the writer of the job
+        BgzfWriter::Job * job;  //!< the job
+    };
+
+    BgzfPool(BgzfPool const &) = delete;
+    BgzfPool & operator = (BgzfPool const &) = delete;
+
+    void submit(BgzfWriter * writer, BgzfWriter::Job * job);
+    void run();
+
+    unsigned int max_threads;           //!< the maximum number of threads
+    std::deque <Task> pending;          //!< jobs waiting for a thread
+    bool stopped;                       //!< whether the threads should quit
+    std::mutex mutex;                   //!< the lock of the queue
+    std::condition_variable work;       //!< notified when a job is queued
+    std::vector <std::thread> threads;  //!< the compressing threads
+};
+
+#endif // GZIP_H
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <locale>
+#include <stdlib.h>
+
+#include "library.h"
+#include "options.h"
+#include "search.h"
+#include "version.h"
+
+/*! \brief Print program parameters */
+void print_help()
+{
+    std::cerr << "Usage:" << std::endl;
+    std::cerr << "index --fragments fragments.dat -o library.idx [--revcomp] [--errors 1] [--edit_distance] [--bloom 10] [--window 10 [--minimizer_k 21] [--min_hits 1] [--verify]]" << std::endl;
+	show_version();
+}
+
+/*! \brief The main function of the **index** tool. */
+int main(int argc, char ** argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, 0, options, print_help)) {
+        return -1;
+    }
+
+    Library library;
+    SharedIndex shared_index;
+    if (!setup_library(options, library, shared_index)) {
+        return -1;
+    }
+
+    std::cerr << "Writing index..." << std::endl;
+    if (!library.save(options.output)) {
+        std::cerr << "Cannot write index file" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include "kmerset.h"
+#include "search.h"
+
+#include <algorithm>
+
+/*! \brief The value marking empty hash table slots
+ *
+ *  No k-mer of length up to KmerSet::max_k is packed into this value.
+ */
+static const uint64_t empty_slot = ~(uint64_t)0;
+
+/*! \brief Pack a k-mer into a 64-bit integer
+ *
+ *  \param[in]  kmer    a k-mer of at most KmerSet::max_k bases
+ *  \param[out] code    the packed k-mer
+ *  \return             whether the k-mer consists of A, C, G and T only
+ */
+bool encode_kmer(const std::string & kmer, uint64_t & code)
+{
+    code = 0;
+    for (auto it = kmer.begin(); it != kmer.end(); ++it) {
+        unsigned char c = base_code(*it);
+        if (c > 3) {
+            return false;
+        }
+        code = (code << 2) | c;
+    }
+    return true;
+}
+
+/*! \brief Get the reverse complement of a packed k-mer
+ *
+ *  \param[in]  kmer    a packed k-mer
+ *  \param[in]  k       the k-mer length
+ *  \return             the packed reverse complement of the k-mer
+ */
+uint64_t reverse_complement(uint64_t kmer, size_t k)
+{
+    uint64_t res = 0;
+    for (size_t i = 0; i < k; ++i) {
+        res = (res << 2) | (3 - (kmer & 3));
+        kmer >>= 2;
+    }
+    return res;
+}
+
+/*! \brief Add a packed k-mer to a hash table
+ *
+ *  \param[in,out]  table   a hash table of packed k-mers
+ *  \param[in]      kmer    a packed k-mer
+ *  \param[in]      hash    the hash value of the k-mer
+ *  \return                 whether the k-mer was not in the table
+ */
+static bool insert(std::vector <uint64_t> & table, uint64_t kmer, uint64_t hash)
+{
+    size_t mask = table.size() - 1;
+    size_t i = hash & mask;
+    while (table[i] != empty_slot) {
+        if (table[i] == kmer) {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+    table[i] = kmer;
+    return true;
+}
+
+/*! \brief Build the set from a list of k-mers
+ *
+ *  K-mers of other lengths and k-mers with bases other than A, C, G and T
+ *  are skipped.
+ *
+ *  \param[in]  kmers       k-mers of the same length consisting of A, C, G
+ *                          and T
+ *  \param[in]  k           the k-mer length
+ *  \param[in]  canonical   whether k-mers should be found on both strands
+ *  \param[in]  bloom_bits  the number of Bloom filter bits per k-mer or 0 if
+ *                          the filter should not be built
+ */
+void KmerSet::build(std::vector <std::string> const & kmers, size_t k, bool canonical,
+                    size_t bloom_bits)
+{
+    std::vector <uint64_t> codes;
+    codes.reserve(kmers.size());
+    for (auto it = kmers.begin(); it != kmers.end(); ++it) {
+        uint64_t code;
+        if (it->size() == k && encode_kmer(*it, code)) {
+            codes.push_back(code);
+        }
+    }
+    build(codes, k, canonical, bloom_bits);
+}
+
+/*! \brief Build the set from a list of packed k-mers
+ *
+ *  The hash table size is a power of two at least twice as large as the
+ *  number of k-mers.
+ *
+ *  \param[in]  codes       packed k-mers of the same length
+ *  \param[in]  k           the k-mer length
+ *  \param[in]  canonical   whether k-mers should be found on both strands
+ *  \param[in]  bloom_bits  the number of Bloom filter bits per k-mer or 0 if
+ *                          the filter should not be built
+ */
+void KmerSet::build(std::vector <uint64_t> const & codes, size_t k, bool canonical,
+                    size_t bloom_bits)
+{
+    this->k = k;
+    this->canonical = canonical;
+    count = 0;
+    size_t size = 16;
+    while (size < codes.size() * 2) {
+        size <<= 1;
+    }
+    std::vector <uint64_t> slots(size, empty_slot);
+    std::vector <uint64_t> hashes;
+    for (auto it = codes.begin(); it != codes.end(); ++it) {
+        uint64_t code = canonical ? std::min(*it, reverse_complement(*it, k)) : *it;
+        uint64_t hash = hash_kmer(code);
+        if (insert(slots, code, hash)) {
+            ++count;
+            if (bloom_bits) {
+                hashes.push_back(hash);
+            }
+        }
+    }
+    table.assign(slots);
+    filter.build(hashes, bloom_bits);
+}
+
+/*! \brief Check if the set contains a k-mer
+ *
+ *  \param[in]  kmer    a packed k-mer
+ *  \return             whether the k-mer is in the set
+ */
+bool KmerSet::contains(uint64_t kmer) const
+{
+    uint64_t hash = hash_kmer(kmer);
+    if (!filter.empty() && !filter.contains(hash)) {
+        return false;
+    }
+    size_t mask = table.size() - 1;
+    size_t i = hash & mask;
+    while (table[i] != empty_slot) {
+        if (table[i] == kmer) {
+            return true;
+        }
+        i = (i + 1) & mask;
+    }
+    return false;
+}
+
+/*! \brief Search for k-mers of the set in a text prefix
+ *
+ *  K-mers containing characters other than A, C, G and T are skipped. For a
+ *  canonical set the reverse complement of each text k-mer is rolled along
+ *  with its forward form and the smaller of them is looked up.
+ *
+ *  \param[in]  text    a text of base codes (see normalize_bases()) to search
+ *                      k-mers in
+ *  \param[in]  length  the length of the text prefix to search k-mers in
+ *  \return             whether any k-mer of the set occurs in the prefix
+ */
+bool KmerSet::search(const std::string & text, size_t length) const
+{
+    if (empty()) {
+        return false;
+    }
+    uint64_t mask = ((uint64_t)1 << (2 * k)) - 1;
+    size_t shift = 2 * (k - 1);
+    uint64_t kmer = 0;
+    uint64_t rc_kmer = 0;
+    size_t valid = 0;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = text[i];
+        if (c > 3) {
+            valid = 0;
+            continue;
+        }
+        kmer = ((kmer << 2) | c) & mask;
+        rc_kmer = (rc_kmer >> 2) | ((uint64_t)(3 - c) << shift);
+        if (++valid >= k && contains(canonical ? std::min(kmer, rc_kmer) : kmer)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! \brief Get the size of memory allocated for the set
+ *
+ *  \return     the number of bytes
+ */
+size_t KmerSet::memory() const
+{
+    return table.memory() + filter.memory();
+}
+
+/*! \brief Check if tables of a set loaded from an index file are consistent
+ *
+ *  The hash table size must be a power of two and the table must have an
+ *  empty slot, so probing stops.
+ *
+ *  \return     whether the set may be searched
+ */
+bool KmerSet::valid() const
+{
+    size_t size = table.size();
+    return empty() ||
+           (k > 0 && k <= max_k && size && !(size & (size - 1)) &&
+            std::find(table.begin(), table.end(), empty_slot) != table.end() && filter.valid());
+}
@@ -0,0 +1,77 @@
+#ifndef KMERSET_H
+#define KMERSET_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "array.h"
+#include "bloom.h"
+
+/*! \brief A set of fixed-length k-mers
+ *
+ *  The class keeps k-mers packed into 64-bit integers (2 bits per base) in an
+ *  open-addressing hash table with linear probing. A text is scanned with a
+ *  rolling 2-bit encoding, so the set makes one probe per text position.
+ *
+ *  A canonical set keeps the smaller of the packed forward and reverse
+ *  complement forms of each k-mer and finds k-mers from both strands.
+ *
+ *  An optional Bloom filter of the k-mers is checked before the hash table,
+ *  so most text k-mers missing from a large set are rejected without
+ *  probing the table.
+ */
+class KmerSet
+{
+public:
+    /*! \brief The maximum supported k-mer length */
+    static const size_t max_k = 31;
+
+    /*! \brief Initialize an empty k-mer set */
+    KmerSet() : k(0), count(0), canonical(false) {}
+
+    void build(std::vector <std::string> const & kmers, size_t k, bool canonical = false,
+               size_t bloom_bits = 0);
+    void build(std::vector <uint64_t> const & codes, size_t k, bool canonical = false,
+               size_t bloom_bits = 0);
+    bool contains(uint64_t kmer) const;
+    bool search(const std::string & text, size_t length) const;
+    size_t memory() const;
+    bool valid() const;
+
+    /*! \brief Check if the set is empty
+     *
+     *  \return     whether the set contains no k-mers
+     */
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    size_t k;       //!< the k-mer length
+    size_t count;   //!< the number of k-mers in the set
+    bool canonical; //!< whether the set keeps canonical k-mers
+    Array <uint64_t> table;         //!< the hash table of packed k-mers
+    BloomFilter filter;             //!< the filter of hash values of the k-mers
+};
+
+/*! \brief Mix bits of a packed k-mer to get its hash value
+ *
+ *  \param[in]  kmer    a packed k-mer
+ *  \return             the hash value of the k-mer
+ */
+inline uint64_t hash_kmer(uint64_t kmer)
+{
+    kmer ^= kmer >> 33;
+    kmer *= 0xff51afd7ed558ccdULL;
+    kmer ^= kmer >> 33;
+    kmer *= 0xc4ceb9fe1a85ec53ULL;
+    kmer ^= kmer >> 33;
+    return kmer;
+}
+
+bool encode_kmer(const std::string & kmer, uint64_t & code);
+uint64_t reverse_complement(uint64_t kmer, size_t k);
+
+#endif // KMERSET_H
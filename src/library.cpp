@@ -0,0 +1,683 @@
+#include "library.h"
+
+#include <map>
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*! \brief The signature of an index file */
+static const char index_magic[8] = {'C', 'C', 'I', 'N', 'D', 'E', 'X', 0};
+
+/*! \brief The version of the index file format
+ *
+ *  The version should be increased whenever the layout of the structures
+ *  saved to an index file changes.
+ */
+static const uint32_t index_version = 4;
+
+/*! \brief The value used to check the byte order of an index file */
+static const uint32_t index_byte_order = 0x01020304;
+
+/*! \brief Find the most common length of adapter k-mers
+ *
+ *  Only k-mers consisting of A, C, G and T that are not longer than
+ *  KmerSet::max_k are taken into account.
+ *
+ *  \param[in]  patterns    a list of patterns
+ *  \return                 the most common length or 0 if there are no such
+ *                          k-mers
+ */
+static size_t common_kmer_length(std::vector <std::pair <std::string, Node::Type> > const & patterns)
+{
+    std::map <size_t, size_t> lengths;
+    for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+        uint64_t code;
+        if (it->second == Node::Type::adapter && !it->first.empty() &&
+                it->first.size() <= KmerSet::max_k && encode_kmer(it->first, code)) {
+            ++lengths[it->first.size()];
+        }
+    }
+    size_t k = 0;
+    size_t count = 0;
+    for (auto it = lengths.begin(); it != lengths.end(); ++it) {
+        if (it->second > count) {
+            k = it->first;
+            count = it->second;
+        }
+    }
+    return k;
+}
+
+/*! \brief Add reverse complements of adapter patterns to a list of patterns
+ *
+ *  Palindromic patterns are not duplicated.
+ *
+ *  \param[in,out]  patterns    a list of patterns
+ */
+static void add_reverse_complements(std::vector <std::pair <std::string, Node::Type> > & patterns)
+{
+    size_t size = patterns.size();
+    for (size_t i = 0; i < size; ++i) {
+        if (patterns[i].second == Node::Type::adapter) {
+            std::string rc = reverse_complement(patterns[i].first);
+            if (rc != patterns[i].first) {
+                patterns.push_back(std::make_pair(rc, Node::Type::adapter));
+            }
+        }
+    }
+}
+
+/*! \brief Build string matching structures from the library patterns
+ *
+ *  Patterns other than adapters are put into Library::runs or
+ *  Library::specials and always searched exactly. For inexact search adapter patterns are put into
+ *  Library::seeds.
+ *
+ *  For exact search adapter k-mers of the most common length are put into
+ *  Library::kmers, adapter patterns with IUPAC codes of degenerate bases are
+ *  put into Library::seeds or, if they have no long enough anchor and fit
+ *  into a Shift-And word, into Library::degenerate, the rest of the adapter
+ *  patterns are compiled into Library::automaton. Long patterns without an
+ *  anchor are searched by Library::seeds with shorter seeds or, if they
+ *  have no A, C, G or T bases, verified at every read position.
+ *
+ *  To search patterns on both strands, the k-mer set keeps canonical k-mers,
+ *  while reverse complements of other adapter patterns are added to the
+ *  structures they are searched with.
+ *
+ *  \param[in]  errors          the number of resolved errors between a read
+ *                              and a pattern
+ *  \param[in]  both_strands    whether patterns should be searched on both
+ *                              read strands
+ *  \param[in]  edit            whether insertions and deletions are counted
+ *                              as errors
+ *  \param[in]  bloom_bits      the number of bits per k-mer of the Bloom
+ *                              filter checked before the k-mer set or 0 if
+ *                              the filter should not be built
+ */
+void Library::build(int errors, bool both_strands, bool edit, size_t bloom_bits)
+{
+    this->errors = errors;
+    this->edit = edit;
+    this->both_strands = both_strands;
+
+    size_t k = errors ? 0 : common_kmer_length(patterns);
+    std::vector <std::string> fixed;
+    std::vector <std::string> anchored;
+    std::vector <std::string> masked;
+    std::vector <std::pair <std::string, Node::Type> > rest;
+    adapters = 0;
+    for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+        uint64_t code;
+        std::vector <std::pair <size_t, size_t> > anchor;
+        if (it->second != Node::Type::adapter) {
+            continue;
+        }
+        ++adapters;
+        if (!errors && !is_degenerate(it->first)) {
+            if (it->first.size() == k && encode_kmer(it->first, code)) {
+                fixed.push_back(it->first);
+            } else {
+                rest.push_back(*it);
+            }
+        } else if (errors || it->first.size() > ShiftAnd::max_length ||
+                   find_seeds(it->first, 1, anchor) >= SeedSet::min_seed) {
+            anchored.push_back(it->first);
+            if (both_strands) {
+                anchored.push_back(reverse_complement(it->first));
+            }
+        } else {
+            masked.push_back(it->first);
+            if (both_strands) {
+                masked.push_back(reverse_complement(it->first));
+            }
+        }
+    }
+    kmers.build(fixed, k, both_strands, bloom_bits);
+    seeds.build(anchored, errors, edit);
+    degenerate.build(masked);
+    if (both_strands) {
+        add_reverse_complements(rest);
+    }
+    Trie trie;
+    build_trie(trie, rest);
+    build_automaton(trie, automaton);
+    build_specials();
+}
+
+/*! \brief Build the minimizer set from the library patterns
+ *
+ *  Adapter patterns are treated as long library sequences: only their
+ *  minimizers are kept in Library::minimizers, which is much smaller than
+ *  the structures built by build(), and a read is reported as matching if
+ *  it shares enough minimizers with the library.
+ *
+ *  \param[in]  k               the k-mer length
+ *  \param[in]  window          the number of k-mers in a window
+ *  \param[in]  min_hits        the number of minimizers of a read which
+ *                              should be found in the library
+ *  \param[in]  verify          whether minimizer hits should be verified
+ *                              against the library patterns
+ *  \param[in]  both_strands    whether patterns should be searched on both
+ *                              read strands
+ *  \param[in]  bloom_bits      the number of Bloom filter bits per minimizer
+ *                              or 0 if the filter should not be built
+ */
+void Library::build_minimizers(size_t k, size_t window, size_t min_hits, bool verify,
+                               bool both_strands, size_t bloom_bits)
+{
+    errors = 0;
+    edit = false;
+    this->both_strands = both_strands;
+    std::vector <std::string> sequences;
+    for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+        if (it->second == Node::Type::adapter) {
+            sequences.push_back(it->first);
+        }
+    }
+    adapters = sequences.size();
+    minimizers.build(sequences, k, window, min_hits, verify, both_strands, bloom_bits);
+    build_specials();
+}
+
+/*! \brief Build matchers of patterns other than adapters
+ *
+ *  Homopolymer patterns are put into Library::runs, the rest of the patterns
+ *  are compiled into Library::specials.
+ */
+void Library::build_specials()
+{
+    std::vector <std::pair <std::string, Node::Type> > rest;
+    runs.clear();
+    for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+        if (it->second != Node::Type::adapter && !runs.add(it->first, it->second)) {
+            rest.push_back(*it);
+        }
+    }
+    Trie trie;
+    build_trie(trie, rest);
+    build_automaton(trie, specials);
+}
+
+/*! \brief Search for patterns other than adapters in a text
+ *
+ *  \param[in]      text    a text of base codes to search pattern matches in
+ *  \param[in,out]  end     the length of the text prefix to search matches
+ *                          in, replaced with the end of the first match
+ *  \return                 an identified match type
+ */
+Node::Type Library::search_specials(const std::string & text, size_t & end) const
+{
+    Node::Type type = Node::Type::no_match;
+    if (!runs.empty()) {
+        size_t pos;
+        type = runs.search(text, pos, end);
+        if (type) {
+            end = pos + 1;
+        }
+    }
+    if (!specials.empty()) {
+        size_t pos;
+        Node::Type special = search_any(text, specials, pos, end);
+        if (special) {
+            end = pos + 1;
+            type = special;
+        }
+    }
+    return type;
+}
+
+/*! \brief Search for adapters in a text prefix by matchers other than the automaton
+ *
+ *  \param[in]      text        a text of base codes to search pattern matches in
+ *  \param[in]      end         the length of the text prefix to search matches in
+ *  \param[in]      type        the type of a match found in the prefix before
+ *  \param[in,out]  workspace   buffers for the search
+ *  \return                     an identified match type
+ */
+Node::Type Library::search_rest(const std::string & text, size_t end, Node::Type type,
+                                SearchWorkspace & workspace) const
+{
+    if (!seeds.empty()) {
+        size_t pos = seeds.search(text, end, workspace.costs);
+        if (pos < end) {
+            end = pos + 1;
+            type = Node::Type::adapter;
+        }
+    }
+    if (!degenerate.empty()) {
+        size_t pos = degenerate.search(text, end);
+        if (pos < end) {
+            end = pos + 1;
+            type = Node::Type::adapter;
+        }
+    }
+    if (kmers.search(text, end) || minimizers.search(text, end)) {
+        return Node::Type::adapter;
+    }
+    return type;
+}
+
+/*! \brief Search for library patterns in a batch of normalized texts
+ *
+ *  The matchers of patterns other than adapters find the first match of
+ *  their patterns, then the other matchers are searched up to the end of
+ *  that match. Adapter matches take precedence over matches of other types
+ *  ending at the same position. The texts are passed through the adapter
+ *  automaton together by search_batch(), which hides the latency of its
+ *  memory accesses for large libraries.
+ *
+ *  \param[in]      texts       texts converted to base codes by
+ *                              normalize_bases() to search pattern matches in
+ *  \param[in]      count       the number of texts
+ *  \param[out]     types       identified match types
+ *  \param[in,out]  workspace   buffers for the search
+ */
+void Library::search_normalized(const std::string * const texts[], size_t count, Node::Type types[],
+                                SearchWorkspace & workspace) const
+{
+    std::vector <size_t> & ends = workspace.ends;
+    std::vector <Node::Type> & matches = workspace.matches;
+    ends.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        ends[i] = texts[i]->size();
+        types[i] = search_specials(*texts[i], ends[i]);
+    }
+    if (!automaton.empty()) {
+        matches.resize(count);
+        search_batch(texts, count, automaton, ends.data(), matches.data());
+        for (size_t i = 0; i < count; ++i) {
+            if (matches[i]) {
+                ++ends[i];
+                types[i] = Node::Type::adapter;
+            }
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        types[i] = search_rest(*texts[i], ends[i], types[i], workspace);
+    }
+}
+
+/*! \brief Get the size of memory allocated for string matching structures
+ *
+ *  \return     the number of bytes
+ */
+size_t Library::memory() const
+{
+    return runs.memory() + specials.memory() + automaton.memory() + kmers.memory() +
+           seeds.memory() + degenerate.memory() + minimizers.memory();
+}
+
+/*! \brief The library destructor
+ *
+ *  Unmaps the index file the library was loaded from.
+ */
+Library::~Library()
+{
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+/*! \brief Write a value to an index file
+ *
+ *  \param[out] out     an index file stream
+ *  \param[in]  value   a value
+ */
+static void write_value(std::ofstream & out, uint64_t value)
+{
+    out.write((const char *)&value, sizeof(value));
+}
+
+/*! \brief Write an array to an index file
+ *
+ *  Items are padded to a multiple of 8 bytes, so all arrays in the file are
+ *  aligned.
+ *
+ *  \param[out] out     an index file stream
+ *  \param[in]  array   an array
+ */
+template <typename T>
+static void write_array(std::ofstream & out, Array <T> const & array)
+{
+    static const char padding[8] = {0};
+    write_value(out, array.size());
+    out.write((const char *)array.data(), array.memory());
+    out.write(padding, (8 - array.memory() % 8) % 8);
+}
+
+/*! \brief Write an automaton to an index file
+ *
+ *  \param[out] out         an index file stream
+ *  \param[in]  automaton   an automaton
+ */
+static void write_automaton(std::ofstream & out, Automaton const & automaton)
+{
+    write_array(out, automaton.transitions);
+    write_array(out, automaton.types);
+    write_array(out, automaton.first_outputs);
+    write_array(out, automaton.outputs);
+}
+
+/*! \brief Save structures built from adapter patterns to an index file
+ *
+ *  \param[in]  path    the index file name
+ *  \return             whether the index file was written
+ */
+bool Library::save(std::string const & path) const
+{
+    std::ofstream out(path.c_str(), std::ofstream::out | std::ofstream::binary);
+    if (!out.good()) {
+        return false;
+    }
+    out.write(index_magic, sizeof(index_magic));
+    out.write((const char *)&index_version, sizeof(index_version));
+    out.write((const char *)&index_byte_order, sizeof(index_byte_order));
+    write_value(out, key);
+    write_value(out, adapters);
+    write_value(out, errors);
+    write_value(out, edit);
+    write_value(out, both_strands);
+    write_automaton(out, automaton);
+    write_value(out, kmers.k);
+    write_value(out, kmers.count);
+    write_value(out, kmers.canonical);
+    write_array(out, kmers.table);
+    write_array(out, kmers.filter.bits);
+    write_value(out, seeds.errors);
+    write_value(out, seeds.edit);
+    write_automaton(out, seeds.automaton);
+    write_array(out, seeds.masks);
+    write_array(out, seeds.offsets);
+    write_value(out, degenerate.words);
+    write_array(out, degenerate.masks);
+    write_array(out, degenerate.starts);
+    write_array(out, degenerate.ends);
+    write_value(out, minimizers.window);
+    write_value(out, minimizers.min_hits);
+    write_value(out, minimizers.verify);
+    write_value(out, minimizers.minimizers.k);
+    write_value(out, minimizers.minimizers.count);
+    write_value(out, minimizers.minimizers.canonical);
+    write_array(out, minimizers.minimizers.table);
+    write_array(out, minimizers.minimizers.filter.bits);
+    write_array(out, minimizers.sequences);
+    write_array(out, minimizers.codes);
+    write_array(out, minimizers.positions);
+    out.close();
+    return !out.fail();
+}
+
+/*! \brief Read a value from a mapped index file
+ *
+ *  \param[in,out]  curr    the current position in the file
+ *  \param[in]      end     the end of the file
+ *  \param[out]     value   the value
+ *  \return                 whether the value was read
+ */
+static bool read_value(const char * & curr, const char * end, uint64_t & value)
+{
+    if ((size_t)(end - curr) < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, curr, sizeof(value));
+    curr += sizeof(value);
+    return true;
+}
+
+/*! \brief Check the signature, the format version and the byte order of an index file
+ *
+ *  \param[in,out]  curr    the beginning of the file, moved past the header
+ *  \param[in]      end     the end of the file
+ *  \return                 whether the file is an index of this version
+ */
+static bool read_header(const char * & curr, const char * end)
+{
+    uint32_t version;
+    uint32_t byte_order;
+    if ((size_t)(end - curr) < sizeof(index_magic) + sizeof(version) + sizeof(byte_order) ||
+            std::memcmp(curr, index_magic, sizeof(index_magic)) != 0) {
+        return false;
+    }
+    curr += sizeof(index_magic);
+    std::memcpy(&version, curr, sizeof(version));
+    curr += sizeof(version);
+    std::memcpy(&byte_order, curr, sizeof(byte_order));
+    curr += sizeof(byte_order);
+    return version == index_version && byte_order == index_byte_order;
+}
+
+/*! \brief Refer an array to its items in a mapped index file
+ *
+ *  \param[in,out]  curr    the current position in the file
+ *  \param[in]      end     the end of the file
+ *  \param[out]     array   the array
+ *  \return                 whether the array was read
+ */
+template <typename T>
+static bool read_array(const char * & curr, const char * end, Array <T> & array)
+{
+    uint64_t size;
+    if (!read_value(curr, end, size) || size > (size_t)(end - curr) / sizeof(T)) {
+        return false;
+    }
+    size_t bytes = size * sizeof(T);
+    bytes += (8 - bytes % 8) % 8;
+    if (bytes > (size_t)(end - curr)) {
+        return false;
+    }
+    array.refer((const T *)curr, size);
+    curr += bytes;
+    return true;
+}
+
+/*! \brief Refer an automaton to its tables in a mapped index file
+ *
+ *  \param[in,out]  curr        the current position in the file
+ *  \param[in]      end         the end of the file
+ *  \param[out]     automaton   the automaton
+ *  \return                     whether the automaton was read
+ */
+static bool read_automaton(const char * & curr, const char * end, Automaton & automaton)
+{
+    return read_array(curr, end, automaton.transitions) &&
+           read_array(curr, end, automaton.types) &&
+           read_array(curr, end, automaton.first_outputs) &&
+           read_array(curr, end, automaton.outputs);
+}
+
+/*! \brief Load structures built from adapter patterns from an index file
+ *
+ *  The index file is mapped to memory read-only and the structures refer to
+ *  it. Patterns other than adapters are taken from Library::patterns.
+ *  Since a shared index may be published by any process, the indices kept
+ *  in the tables are checked to lie in range before the library is used.
+ *
+ *  \param[in]  path    the index file name
+ *  \return             whether the index file was loaded
+ */
+bool Library::load(std::string const & path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void * data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    mapping = data;
+    mapping_size = info.st_size;
+
+    const char * curr = (const char *)data;
+    const char * end = curr + mapping_size;
+    if (!read_header(curr, end)) {
+        return false;
+    }
+
+    uint64_t values[16];
+    bool good = read_value(curr, end, key) &&
+                read_value(curr, end, values[0]) &&
+                read_value(curr, end, values[1]) &&
+                read_value(curr, end, values[2]) &&
+                read_value(curr, end, values[3]) &&
+                read_automaton(curr, end, automaton) &&
+                read_value(curr, end, values[4]) &&
+                read_value(curr, end, values[5]) &&
+                read_value(curr, end, values[6]) &&
+                read_array(curr, end, kmers.table) &&
+                read_array(curr, end, kmers.filter.bits) &&
+                read_value(curr, end, values[7]) &&
+                read_value(curr, end, values[8]) &&
+                read_automaton(curr, end, seeds.automaton) &&
+                read_array(curr, end, seeds.masks) &&
+                read_array(curr, end, seeds.offsets) &&
+                read_value(curr, end, values[9]) &&
+                read_array(curr, end, degenerate.masks) &&
+                read_array(curr, end, degenerate.starts) &&
+                read_array(curr, end, degenerate.ends) &&
+                read_value(curr, end, values[10]) &&
+                read_value(curr, end, values[11]) &&
+                read_value(curr, end, values[12]) &&
+                read_value(curr, end, values[13]) &&
+                read_value(curr, end, values[14]) &&
+                read_value(curr, end, values[15]) &&
+                read_array(curr, end, minimizers.minimizers.table) &&
+                read_array(curr, end, minimizers.minimizers.filter.bits) &&
+                read_array(curr, end, minimizers.sequences) &&
+                read_array(curr, end, minimizers.codes) &&
+                read_array(curr, end, minimizers.positions);
+    if (!good) {
+        return false;
+    }
+    adapters = values[0];
+    errors = values[1];
+    edit = values[2];
+    both_strands = values[3];
+    kmers.k = values[4];
+    kmers.count = values[5];
+    kmers.canonical = values[6];
+    seeds.errors = values[7];
+    seeds.edit = values[8];
+    seeds.select_kernel();
+    degenerate.words = values[9];
+    minimizers.window = values[10];
+    minimizers.min_hits = values[11];
+    minimizers.verify = values[12];
+    minimizers.minimizers.k = values[13];
+    minimizers.minimizers.count = values[14];
+    minimizers.minimizers.canonical = values[15];
+    if (!automaton.valid() || !kmers.valid() || !seeds.valid() || !degenerate.valid() ||
+            !minimizers.valid()) {
+        return false;
+    }
+    build_specials();
+    return true;
+}
+
+/*! \brief Read the key of an index file without loading it
+ *
+ *  \param[in]  path    the index file name
+ *  \param[out] key     the key the index was saved with
+ *  \return             whether the file is an index of this version
+ */
+bool Library::read_key(std::string const & path, uint64_t & key)
+{
+    char header[sizeof(index_magic) + 2 * sizeof(uint32_t) + sizeof(uint64_t)];
+    std::ifstream in(path.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!in.read(header, sizeof(header))) {
+        return false;
+    }
+    const char * curr = header;
+    const char * end = header + sizeof(header);
+    return read_header(curr, end) && read_value(curr, end, key);
+}
+
+/*! \brief Compute the hash of adapter patterns and options used to build the library
+ *
+ *  The hash covers the index format version, so indices built for equal
+ *  patterns and options by different versions have different hashes.
+ *
+ *  \param[in]  options     the options the structures are built with
+ *  \return                 the 64-bit FNV-1a hash
+ */
+uint64_t Library::hash(std::vector <int> const & options) const
+{
+    uint64_t value = 0xcbf29ce484222325ULL;
+    auto update = [&value] (const char * data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            value = (value ^ (unsigned char)data[i]) * 0x100000001b3ULL;
+        }
+    };
+    update((const char *)&index_version, sizeof(index_version));
+    for (auto it = options.begin(); it != options.end(); ++it) {
+        update((const char *)&*it, sizeof(*it));
+    }
+    for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+        if (it->second == Node::Type::adapter) {
+            update(it->first.c_str(), it->first.size() + 1);
+        }
+    }
+    return value;
+}
+
+/*! \brief Read adapter patterns from an input stream
+ *
+ *  The stream contains either a pattern per line, optionally followed by a
+ *  tab and other fields, or sequences in the FASTA format.
+ *
+ *  \param[in]  kmers_f     an input stream to read the patterns from
+ *  \param[out] patterns    the vector to which the patterns are written
+ */
+void read_patterns(std::istream & kmers_f, std::vector <std::pair <std::string, Node::Type> > & patterns)
+{
+    std::string tmp;
+    bool fasta = false;
+    while (!kmers_f.eof()) {
+        std::getline(kmers_f, tmp);
+        std::transform(tmp.begin(), tmp.end(), tmp.begin(), ::toupper);
+        if (!tmp.empty() && tmp[0] == '>') {
+            fasta = true;
+            patterns.push_back(std::make_pair(std::string(), Node::Type::adapter));
+        } else if (!tmp.empty() && fasta) {
+            patterns.back().first += tmp;
+        } else if (!tmp.empty()) {
+            size_t tab = tmp.find('\t');
+            if (tab == std::string::npos) {
+                patterns.push_back(std::make_pair(tmp, Node::Type::adapter));
+            } else {
+                patterns.push_back(std::make_pair(tmp.substr(0, tab), Node::Type::adapter));
+            }
+        }
+    }
+}
+
+/*! \brief Add the N, poly-G/poly-C and poly-A/poly-T patterns to a list of patterns
+ *
+ *  \param[in]  polyG       the length of poly-G and poly-C patterns
+ *  \param[in]  polyA       the length of poly-A and poly-T patterns
+ *  \param[out] patterns    the vector to which the patterns are written
+ */
+void add_special_patterns(int polyG, int polyA, std::vector <std::pair <std::string, Node::Type> > & patterns)
+{
+    patterns.push_back(std::make_pair("NN", Node::Type::n));
+    if (polyG) {
+        patterns.push_back(std::make_pair(std::string(polyG, 'G'), Node::Type::polyG));
+        patterns.push_back(std::make_pair(std::string(polyG, 'C'), Node::Type::polyC));
+    }
+    if (polyA) {
+        patterns.push_back(std::make_pair(std::string(polyA, 'A'), Node::Type::polyA));
+        patterns.push_back(std::make_pair(std::string(polyA, 'T'), Node::Type::polyT));
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <istream>
+#include <cstdint>
+
+#include "kmerset.h"
+#include "minimizer.h"
+#include "runset.h"
+#include "search.h"
+#include "seedset.h"
+#include "shiftand.h"
+
+/*! \brief Buffers reused by library searches
+ *
+ *  A workspace is owned by the caller of Library::search_normalized() and
+ *  may be used by one thread at a time. The buffers keep their capacity
+ *  between searches, so once they have grown to the size of a read batch,
+ *  searching reads does not allocate memory.
+ */
+struct SearchWorkspace
+{
+    /*! \brief Initialize empty buffers */
+    SearchWorkspace() : block(0), used(0) {}
+
+    std::vector <int> costs;                    //!< edit distances computed by SeedSet verification
+    std::vector <size_t> ends;                  //!< ends of text prefixes searched in a batch
+    std::vector <Node::Type> matches;           //!< automaton matches found in a batch
+    std::vector <std::string> codes;            //!< base codes of the batch texts
+    std::vector <const std::string *> texts;    //!< texts of a batch
+    std::vector <size_t> indices;               //!< indices of the batch texts among reads
+    std::vector <Node::Type> types;             //!< match types found in the batch texts
+    std::vector <std::vector <char> > blocks;   //!< memory of the hash tables counting DUST k-mers
+    size_t block;                               //!< the index of the block being used in SearchWorkspace::blocks
+    size_t used;                                //!< the number of bytes used in the current block
+};
+
+/*! \brief A compiled library of patterns
+ *
+ *  The class keeps patterns for read filtration together with the structures
+ *  built from them for string matching: the homopolymer run matcher, the
+ *  flattened automata, the k-mer set, the seed-and-verify matcher, the
+ *  Shift-And matcher and the minimizer set.
+ *
+ *  Structures built from adapter patterns may be saved to an index file and
+ *  loaded from it later. A loaded library refers to the index file mapped to
+ *  memory, so processes using the same index share its pages.
+ */
+class Library
+{
+public:
+    /*! \brief Initialize an empty library */
+    Library() :
+        adapters(0), errors(0), edit(false), both_strands(false), key(0),
+        mapping(NULL), mapping_size(0)
+    {}
+
+    ~Library();
+
+    void build(int errors = 0, bool both_strands = false, bool edit = false, size_t bloom_bits = 0);
+    void build_minimizers(size_t k, size_t window, size_t min_hits = 1, bool verify = false,
+                          bool both_strands = false, size_t bloom_bits = 0);
+    bool save(std::string const & path) const;
+    bool load(std::string const & path);
+    static bool read_key(std::string const & path, uint64_t & key);
+    uint64_t hash(std::vector <int> const & options) const;
+    void search_normalized(const std::string * const texts[], size_t count, Node::Type types[],
+                           SearchWorkspace & workspace) const;
+    size_t memory() const;
+
+    std::vector <std::pair <std::string, Node::Type> > patterns; //!< patterns for search
+    RunSet runs;            //!< the matcher of homopolymer patterns other than adapters
+    Automaton specials;     //!< the automaton of other patterns which are not adapters
+    Automaton automaton;    //!< the automaton of adapter patterns searched exactly
+    KmerSet kmers;          //!< the set of fixed-length k-mers used for exact search
+    SeedSet seeds;          //!< the seed-and-verify matcher of adapter patterns
+    ShiftAnd degenerate;    //!< the matcher of other patterns with degenerate bases used for exact search
+    MinimizerSet minimizers;    //!< the set of minimizers of adapter patterns used for screening
+    size_t adapters;        //!< the number of adapter patterns
+    int errors;             //!< the number of resolved errors between a read and a pattern
+    bool edit;              //!< whether insertions and deletions are counted as errors
+    bool both_strands;      //!< whether patterns are searched on both read strands
+    uint64_t key;           //!< the hash identifying the patterns and options of an index, 0 if unknown
+
+private:
+    Library(Library const &) = delete;
+    Library & operator = (Library const &) = delete;
+
+    void build_specials();
+    Node::Type search_specials(const std::string & text, size_t & end) const;
+    Node::Type search_rest(const std::string & text, size_t end, Node::Type type,
+                           SearchWorkspace & workspace) const;
+
+    void * mapping;         //!< the index file mapped to memory
+    size_t mapping_size;    //!< the size of the mapped index file
+};
+
+void read_patterns(std::istream & kmers_f, std::vector <std::pair <std::string, Node::Type> > & patterns);
+void add_special_patterns(int polyG, int polyA, std::vector <std::pair <std::string, Node::Type> > & patterns);
+
+#endif // LIBRARY_H
@@ -0,0 +1,262 @@
+#include "minimizer.h"
+#include "search.h"
+
+#include <algorithm>
+
+const size_t MinimizerSet::max_window;
+
+/*! \brief Call a function for each minimizer of a sequence
+ *
+ *  K-mers containing codes other than those of A, C, G and T are skipped,
+ *  so such codes split a sequence into parts. If a part is shorter than a
+ *  window, the minimizer of all its k-mers is taken. A minimizer shared by
+ *  consecutive windows is reported once.
+ *
+ *  \param[in]  text        a sequence of base codes (see normalize_bases())
+ *  \param[in]  length      the length of the sequence
+ *  \param[in]  k           the k-mer length
+ *  \param[in]  window      the number of k-mers in a window
+ *  \param[in]  canonical   whether canonical k-mers should be taken
+ *  \param[in]  callback    the function called with the start position,
+ *                          the packed k-mer and whether the k-mer is taken
+ *                          from the forward strand
+ */
+template <typename Callback>
+static void for_each_minimizer(const char * text, size_t length, size_t k, size_t window,
+                               bool canonical, Callback callback)
+{
+    uint64_t hashes[MinimizerSet::max_window];
+    uint64_t codes[MinimizerSet::max_window];
+    size_t starts[MinimizerSet::max_window];
+    bool forwards[MinimizerSet::max_window];
+    uint64_t mask = ((uint64_t)1 << (2 * k)) - 1;
+    size_t shift = 2 * (k - 1);
+    uint64_t kmer = 0;
+    uint64_t rc_kmer = 0;
+    size_t valid = 0;
+    size_t filled = 0;
+    size_t best = 0;
+    size_t last = ~(size_t)0;
+    for (size_t i = 0; i <= length; ++i) {
+        unsigned char c = (i < length) ? text[i] : 4;
+        if (c > 3) {
+            if (filled && filled < window && starts[best] != last) {
+                last = starts[best];
+                callback(starts[best], codes[best], forwards[best]);
+            }
+            valid = 0;
+            filled = 0;
+            continue;
+        }
+        kmer = ((kmer << 2) | c) & mask;
+        rc_kmer = (rc_kmer >> 2) | ((uint64_t)(3 - c) << shift);
+        if (++valid < k) {
+            continue;
+        }
+        size_t slot = filled % window;
+        bool expired = filled == 0 || best == slot;
+        bool forward = !canonical || kmer <= rc_kmer;
+        codes[slot] = forward ? kmer : rc_kmer;
+        hashes[slot] = hash_kmer(codes[slot]);
+        starts[slot] = i + 1 - k;
+        forwards[slot] = forward;
+        ++filled;
+        if (expired) {
+            best = slot;
+            for (size_t j = 0; j < std::min(filled, window); ++j) {
+                if (hashes[j] < hashes[best] || (hashes[j] == hashes[best] && starts[j] < starts[best])) {
+                    best = j;
+                }
+            }
+        } else if (hashes[slot] < hashes[best]) {
+            best = slot;
+        }
+        if (filled >= window && starts[best] != last) {
+            last = starts[best];
+            callback(starts[best], codes[best], forwards[best]);
+        }
+    }
+}
+
+/*! \brief Build the set from library sequences
+ *
+ *  \param[in]  sequences   library sequences
+ *  \param[in]  k           the k-mer length, at most KmerSet::max_k
+ *  \param[in]  window      the number of k-mers in a window, at most
+ *                          MinimizerSet::max_window
+ *  \param[in]  min_hits    the number of minimizers of a text which should
+ *                          be found in the set to report a match
+ *  \param[in]  verify      whether minimizer hits should be verified against
+ *                          library sequences
+ *  \param[in]  canonical   whether sequences should be found on both strands
+ *  \param[in]  bloom_bits  the number of Bloom filter bits per minimizer or 0
+ *                          if the filter should not be built
+ */
+void MinimizerSet::build(std::vector <std::string> const & sequences, size_t k, size_t window,
+                         size_t min_hits, bool verify, bool canonical, size_t bloom_bits)
+{
+    this->window = window;
+    this->min_hits = std::max(min_hits, (size_t)1);
+    this->verify = verify;
+    std::vector <uint64_t> found;
+    std::vector <std::pair <uint64_t, uint64_t> > occurrences;
+    std::string text;
+    std::string normalized;
+    for (auto it = sequences.begin(); it != sequences.end(); ++it) {
+        size_t offset = text.size();
+        normalize_bases(*it, normalized);
+        for_each_minimizer(normalized.data(), normalized.size(), k, window, canonical,
+            [&](size_t start, uint64_t code, bool) {
+                found.push_back(code);
+                if (verify) {
+                    occurrences.push_back(std::make_pair(code, offset + start));
+                }
+            });
+        if (verify) {
+            text += *it;
+            text.push_back(0);
+        }
+    }
+    minimizers.build(found, k, canonical, bloom_bits);
+    std::sort(occurrences.begin(), occurrences.end());
+    std::vector <char> chars(text.begin(), text.end());
+    std::vector <uint64_t> sorted_codes;
+    std::vector <uint64_t> sorted_positions;
+    for (auto it = occurrences.begin(); it != occurrences.end(); ++it) {
+        sorted_codes.push_back(it->first);
+        sorted_positions.push_back(it->second);
+    }
+    this->sequences.assign(chars);
+    codes.assign(sorted_codes);
+    positions.assign(sorted_positions);
+}
+
+/*! \brief Check if a base code and a character are the same base
+ *
+ *  \param[in]  code    a base code
+ *  \param[in]  c       a character
+ *  \return             whether they are the same base A, C, G or T
+ */
+static inline bool same_base(unsigned char code, char c)
+{
+    return code < 4 && code == base_code(c);
+}
+
+/*! \brief Check if a base code and a character are complementary bases
+ *
+ *  \param[in]  code    a base code
+ *  \param[in]  c       a character
+ *  \return             whether they are complementary bases A, C, G or T
+ */
+static inline bool complementary_bases(unsigned char code, char c)
+{
+    return code < 4 && 3 - code == base_code(c);
+}
+
+/*! \brief Check if a minimizer of a text extends to a long exact match
+ *
+ *  The text k-mer is extended in both directions along every occurrence of
+ *  the minimizer in library sequences, on the opposite strand if the text
+ *  and the library k-mers are taken from different strands.
+ *
+ *  \param[in]  text    a text of base codes
+ *  \param[in]  length  the length of the text prefix to match
+ *  \param[in]  start   the start position of the minimizer in the text
+ *  \param[in]  code    the packed minimizer
+ *  \param[in]  forward whether the minimizer is taken from the forward
+ *                      strand of the text
+ *  \return             whether an exact match of at least w + k - 1 bases
+ *                      or of the whole text prefix was found
+ */
+bool MinimizerSet::verified(const std::string & text, size_t length, size_t start,
+                            uint64_t code, bool forward) const
+{
+    size_t k = minimizers.k;
+    size_t target = std::min(window + k - 1, length);
+    auto range = std::equal_range(codes.begin(), codes.end(), code);
+    for (auto it = range.first; it != range.second; ++it) {
+        size_t pos = positions[it - codes.begin()];
+        uint64_t source = 0;
+        for (size_t i = 0; i < k; ++i) {
+            source = (source << 2) | base_code(sequences[pos + i]);
+        }
+        size_t left = 0;
+        size_t right = 0;
+        if ((source == code) == forward) {
+            while (left < start && left < pos &&
+                    same_base(text[start - left - 1], sequences[pos - left - 1])) {
+                ++left;
+            }
+            while (start + k + right < length && pos + k + right < sequences.size() &&
+                    same_base(text[start + k + right], sequences[pos + k + right])) {
+                ++right;
+            }
+        } else {
+            while (left < start && pos + k + left < sequences.size() &&
+                    complementary_bases(text[start - left - 1], sequences[pos + k + left])) {
+                ++left;
+            }
+            while (start + k + right < length && right < pos &&
+                    complementary_bases(text[start + k + right], sequences[pos - right - 1])) {
+                ++right;
+            }
+        }
+        if (left + k + right >= target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! \brief Search for minimizers of the set in a text prefix
+ *
+ *  \param[in]  text    a text of base codes (see normalize_bases()) to search
+ *                      minimizers in
+ *  \param[in]  length  the length of the text prefix to search minimizers in
+ *  \return             whether at least MinimizerSet::min_hits minimizers of
+ *                      the prefix were found in the set (and verified if
+ *                      verification is enabled)
+ */
+bool MinimizerSet::search(const std::string & text, size_t length) const
+{
+    if (empty()) {
+        return false;
+    }
+    size_t hits = 0;
+    for_each_minimizer(text.data(), length, minimizers.k, window, minimizers.canonical,
+        [&](size_t start, uint64_t code, bool forward) {
+            if (hits < min_hits && minimizers.contains(code) &&
+                    (!verify || verified(text, length, start, code, forward))) {
+                ++hits;
+            }
+        });
+    return hits >= min_hits;
+}
+
+/*! \brief Get the size of memory allocated for the set
+ *
+ *  \return     the number of bytes
+ */
+size_t MinimizerSet::memory() const
+{
+    return minimizers.memory() + sequences.memory() + codes.memory() + positions.memory();
+}
+
+/*! \brief Check if tables of a set loaded from an index file are consistent
+ *
+ *  \return     whether the window size is supported and minimizer positions
+ *              kept for verification lie within the library sequences
+ */
+bool MinimizerSet::valid() const
+{
+    if (!minimizers.valid() || window > max_window || (!empty() && window == 0) ||
+            codes.size() != positions.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < positions.size(); ++i) {
+        if (positions[i] > sequences.size() || sequences.size() - positions[i] < minimizers.k) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef MINIMIZER_H
+#define MINIMIZER_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "array.h"
+#include "kmerset.h"
+
+/*! \brief A set of (w,k)-minimizers of library sequences
+ *
+ *  Of every MinimizerSet::window consecutive k-mers of a sequence, the k-mer
+ *  with the smallest hash value is its minimizer. The set keeps minimizers
+ *  of library sequences only, which takes about 2 / (w + 1) of the memory
+ *  needed for all their k-mers, and reports a text as matching if enough of
+ *  its minimizers are found in the set. Two sequences sharing an exact match
+ *  of at least w + k - 1 bases share a minimizer.
+ *
+ *  If verification is enabled, the set also keeps the library sequences and
+ *  positions of minimizers in them, and a minimizer of a text is only
+ *  counted if it extends to an exact match of w + k - 1 bases between the
+ *  text and a library sequence.
+ */
+class MinimizerSet
+{
+public:
+    /*! \brief The maximum window size */
+    static const size_t max_window = 256;
+
+    /*! \brief Initialize an empty set */
+    MinimizerSet() : window(0), min_hits(1), verify(false) {}
+
+    void build(std::vector <std::string> const & sequences, size_t k, size_t window,
+               size_t min_hits = 1, bool verify = false, bool canonical = false,
+               size_t bloom_bits = 0);
+    bool search(const std::string & text, size_t length) const;
+    size_t memory() const;
+    bool valid() const;
+
+    /*! \brief Check if the set is empty
+     *
+     *  \return     whether the set contains no minimizers
+     */
+    bool empty() const
+    {
+        return minimizers.empty();
+    }
+
+    size_t window;              //!< the number of k-mers in a window
+    size_t min_hits;            //!< the number of minimizers of a text which should be found in the set
+    bool verify;                //!< whether minimizer hits are verified against library sequences
+    KmerSet minimizers;         //!< minimizers of library sequences
+    Array <char> sequences;     //!< library sequences separated by zero characters, kept for verification
+    Array <uint64_t> codes;     //!< sorted minimizers of library sequences, kept for verification
+    Array <uint64_t> positions; //!< positions of the minimizers in the sequences in the order of codes
+
+private:
+    bool verified(const std::string & text, size_t length, size_t start, uint64_t code, bool forward) const;
+};
+
+#endif // MINIMIZER_H
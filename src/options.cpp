@@ -0,0 +1,331 @@
+#include "options.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <getopt.h>
+#include <stdlib.h>
+
+/*! \brief A command line option */
+struct OptionSpec
+{
+    const char * name;  //!< the long name, NULL for an option having only the short one
+    int has_arg;        //!< whether the option has an argument
+    char short_name;    //!< the short name
+    int group;          //!< the group of the option, 0 for an option of all tools
+    bool builds;        //!< whether the option sets how a library is built
+};
+
+/*! \brief The command line options of the tools */
+static const OptionSpec option_specs[] = {
+    {NULL, required_argument, 'o', 0, false},
+    {"fragments", required_argument, 'f', 0, true},
+    {"revcomp", no_argument, 'r', 0, true},
+    {"errors", required_argument, 'e', 0, true},
+    {"edit_distance", no_argument, 'd', 0, true},
+    {"bloom", required_argument, 'b', 0, true},
+    {"window", required_argument, 'w', 0, true},
+    {"minimizer_k", required_argument, 'K', 0, true},
+    {"min_hits", required_argument, 'm', 0, true},
+    {"verify", no_argument, 'v', 0, true},
+    {NULL, required_argument, '1', input_options, false},
+    {NULL, required_argument, '2', input_options, false},
+    {"samples", required_argument, 's', input_options, false},
+    {"threads", required_argument, 't', input_options, false},
+    {NULL, required_argument, 'i', single_options, false},
+    {"length", required_argument, 'l', filter_options, false},
+    {"polygc", required_argument, 'p', filter_options, false},
+    {"polyat", required_argument, 'a', filter_options, false},
+    {"dust_k", required_argument, 'k', filter_options, false},
+    {"dust_cutoff", required_argument, 'c', filter_options, false},
+    {"compress", required_argument, 'z', output_options, false},
+    {"unordered", no_argument, 'u', output_options, false},
+    {"index", required_argument, 'x', index_options, false},
+    {"shared", required_argument, 'S', index_options, true}
+};
+
+/*! \brief Parse and check the command line options of a tool
+ *
+ *  Error messages are written to the standard error stream, followed by
+ *  the tool help if the options are unknown or required ones are missing.
+ *
+ *  \param[in]  argc        the number of command line arguments
+ *  \param[in]  argv        the command line arguments
+ *  \param[in]  groups      the option groups accepted by the tool
+ *  \param[in,out]  options the options, set to the tool defaults before the call
+ *  \param[in]  print_help  the function printing the tool help
+ *  \return                 whether the options are valid
+ */
+bool parse_options(int argc, char ** argv, int groups, Options & options, void (*print_help)())
+{
+    options.groups = groups;
+
+    std::vector <struct option> long_options;
+    std::string short_options;
+    std::string build_options;
+    for (size_t i = 0; i < sizeof(option_specs) / sizeof(option_specs[0]); ++i) {
+        OptionSpec const & spec = option_specs[i];
+        if (spec.group && !(spec.group & groups)) {
+            continue;
+        }
+        short_options += spec.short_name;
+        if (spec.builds) {
+            build_options += spec.short_name;
+        }
+        if (spec.has_arg == required_argument) {
+            short_options += ':';
+        }
+        if (spec.name) {
+            struct option long_option = {spec.name, spec.has_arg, NULL, spec.short_name};
+            long_options.push_back(long_option);
+        }
+    }
+    struct option end = {NULL, 0, NULL, 0};
+    long_options.push_back(end);
+
+    int rez;
+    bool building = false;
+    while ((rez = getopt_long(argc, argv, short_options.c_str(), long_options.data(), NULL)) != -1) {
+        if (rez != '?' && build_options.find((char)rez) != std::string::npos) {
+            building = true;
+        }
+        switch (rez) {
+        case 'o':
+            options.output = optarg;
+            break;
+        case 'f':
+            options.kmers = optarg;
+            break;
+        case 'r':
+            options.revcomp = true;
+            break;
+        case 'e':
+            options.errors = std::atoi(optarg);
+            break;
+        case 'd':
+            options.edit = true;
+            break;
+        case 'b':
+            options.bloom_bits = std::atoi(optarg);
+            break;
+        case 'w':
+            options.window = std::atoi(optarg);
+            break;
+        case 'K':
+            options.minimizer_k = std::atoi(optarg);
+            break;
+        case 'm':
+            options.min_hits = std::atoi(optarg);
+            break;
+        case 'v':
+            options.verify = true;
+            break;
+        case '1':
+            options.reads1 = optarg;
+            break;
+        case '2':
+            options.reads2 = optarg;
+            break;
+        case 's':
+            options.samples_file = optarg;
+            break;
+        case 't':
+            options.threads = std::atoi(optarg);
+            break;
+        case 'i':
+            options.reads = optarg;
+            break;
+        case 'l':
+            options.length = std::atoi(optarg);
+            break;
+        case 'p':
+            options.polyG = std::atoi(optarg);
+            break;
+        case 'a':
+            options.polyA = std::atoi(optarg);
+            break;
+        case 'k':
+            options.dust_k = std::atoi(optarg);
+            break;
+        case 'c':
+            options.dust_cutoff = std::atoi(optarg);
+            break;
+        case 'z':
+            options.compression = std::atoi(optarg);
+            break;
+        case 'u':
+            options.unordered = true;
+            break;
+        case 'x':
+            options.index_file = optarg;
+            break;
+        case 'S':
+            options.shared_dir = optarg;
+            break;
+        default:
+            print_help();
+            return false;
+        }
+    }
+
+    if (options.compression < 0 || options.compression > 9) {
+        std::cerr << "compression level must be between 0 and 9" << std::endl;
+        return false;
+    }
+
+    if (options.threads < 1) {
+        std::cerr << "threads count must be positive" << std::endl;
+        return false;
+    }
+
+    if (options.errors < 0) {
+        std::cerr << "errors count must not be negative" << std::endl;
+        return false;
+    }
+
+    if (options.bloom_bits < 0) {
+        std::cerr << "Bloom filter size must not be negative" << std::endl;
+        return false;
+    }
+
+    if (options.window < 0 || options.window > (int)MinimizerSet::max_window) {
+        std::cerr << "window size must be between 0 and " << MinimizerSet::max_window << std::endl;
+        return false;
+    }
+
+    if (options.minimizer_k < 1 || options.minimizer_k > (int)KmerSet::max_k) {
+        std::cerr << "minimizer length must be between 1 and " << KmerSet::max_k << std::endl;
+        return false;
+    }
+
+    if (!options.index_file.empty() && building) {
+        std::cerr << "library options cannot be used with an index file, "
+                  << "which keeps the options it was built with" << std::endl;
+        return false;
+    }
+
+    if ((options.kmers.empty() && options.index_file.empty()) || options.output.empty() || (
+            (groups & input_options) && options.reads.empty() && options.samples_file.empty() &&
+            (options.reads1.empty() || options.reads2.empty()))) {
+        print_help();
+        return false;
+    }
+
+    return true;
+}
+
+/*! \brief Get the samples to process from the options
+ *
+ *  The samples are read from the manifest if it is given, otherwise the
+ *  reads files of the options make up a single sample. Tools reading no
+ *  single-end reads require paired-end reads in the manifest, and tools
+ *  writing output files require the files of samples to have distinct names.
+ *
+ *  \param[in]  options     the options
+ *  \param[out] samples     the samples
+ *  \return                 whether the samples are valid
+ */
+bool read_samples(Options const & options, std::vector <Sample> & samples)
+{
+    if (options.samples_file.empty()) {
+        samples.push_back(Sample());
+        samples.back().reads = options.reads;
+        samples.back().reads1 = options.reads1;
+        samples.back().reads2 = options.reads2;
+        return true;
+    }
+
+    if (!read_manifest(options.samples_file, samples) || samples.empty()) {
+        std::cerr << "Cannot read samples file" << std::endl;
+        return false;
+    }
+    if ((options.groups & output_options) && !distinct_names(samples)) {
+        std::cerr << "Files of samples must have distinct names" << std::endl;
+        return false;
+    }
+    if (!(options.groups & single_options)) {
+        for (auto it = samples.begin(); it != samples.end(); ++it) {
+            if (it->reads1.empty()) {
+                std::cerr << "Samples must have paired-end reads" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*! \brief Load or build the library of patterns given by the options
+ *
+ *  The library is loaded from an index file, attached to an index shared
+ *  with other processes or built from the file of patterns. Tools filtering
+ *  reads by N bases and homopolymers add their special patterns to the
+ *  library.
+ *
+ *  \param[in]  options         the options
+ *  \param[out] library         the library
+ *  \param[out] shared_index    the shared index the library is attached to
+ *  \return                     whether the library was set up
+ */
+bool setup_library(Options const & options, Library & library, SharedIndex & shared_index)
+{
+    bool special = options.groups & filter_options;
+    if (!options.index_file.empty()) {
+        if (special) {
+            add_special_patterns(options.polyG, options.polyA, library.patterns);
+        }
+        std::cerr << "Loading index..." << std::endl;
+        if (!library.load(options.index_file)) {
+            std::cerr << "Cannot load index file" << std::endl;
+            return false;
+        }
+    } else {
+        std::ifstream kmers_f (options.kmers.c_str());
+        if (!kmers_f.good()) {
+            std::cerr << "Cannot open kmers file" << std::endl;
+            return false;
+        }
+
+        std::cerr << "Building patterns..." << std::endl;
+        read_patterns(kmers_f, library.patterns);
+        kmers_f.close();
+        if (special) {
+            add_special_patterns(options.polyG, options.polyA, library.patterns);
+        }
+
+        if (library.patterns.empty()) {
+            std::cerr << "patterns are empty" << std::endl;
+            return false;
+        }
+
+        auto build = [&] {
+            if (options.window) {
+                std::cerr << "Building minimizers..." << std::endl;
+                library.build_minimizers(options.minimizer_k, options.window, options.min_hits, options.verify,
+                                         options.revcomp, options.bloom_bits);
+            } else {
+                std::cerr << "Building trie..." << std::endl;
+                library.build(options.errors, options.revcomp, options.edit, options.bloom_bits);
+            }
+        };
+        if (options.shared_dir.empty()) {
+            build();
+        } else {
+            std::cerr << "Attaching shared index..." << std::endl;
+            std::vector <int> key_options = {options.errors, options.revcomp, options.edit, options.bloom_bits,
+                                             options.window, options.minimizer_k, options.min_hits, options.verify};
+            if (!shared_index.attach(library, options.shared_dir, key_options, build)) {
+                std::cerr << "Cannot attach shared index" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    std::cerr << "Library size: " << library.memory() << " bytes, "
+              << library.memory() / std::max(library.adapters, (size_t)1) << " bytes per pattern" << std::endl;
+    BloomFilter const & filter = library.minimizers.empty() ? library.kmers.filter : library.minimizers.minimizers.filter;
+    if (!filter.empty()) {
+        std::cerr << "Bloom filter size: " << filter.memory() << " bytes, "
+                  << "estimated false positive rate " << filter.false_positive_rate() << std::endl;
+    }
+    return true;
+}
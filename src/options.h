@@ -0,0 +1,65 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <vector>
+
+#include "fileroutines.h"
+#include "library.h"
+#include "sharedindex.h"
+
+/*! \brief Groups of command line options accepted by a tool
+ *
+ *  The -o option and the options building a library of patterns are
+ *  accepted by all tools.
+ */
+enum OptionGroup {
+    input_options = 1,      //!< -1, -2, --samples and --threads
+    single_options = 2,     //!< -i
+    filter_options = 4,     //!< --length, --polygc, --polyat, --dust_k and --dust_cutoff
+    output_options = 8,     //!< --compress and --unordered
+    index_options = 16      //!< --index and --shared
+};
+
+/*! \brief Command line options of the tools */
+struct Options
+{
+    /*! \brief Initialize the default options */
+    Options() :
+        groups(0), length(0), polyG(0), polyA(0), dust_k(4), dust_cutoff(0),
+        errors(0), edit(false), revcomp(false), bloom_bits(0), window(0), minimizer_k(21),
+        min_hits(1), verify(false), compression(0), threads(1), unordered(false)
+    {}
+
+    int groups;                 //!< the option groups accepted by the tool
+    std::string kmers;          //!< the file of patterns
+    std::string index_file;     //!< the index file to load
+    std::string shared_dir;     //!< the directory of indices shared by processes
+    std::string reads;          //!< the file of single-end reads
+    std::string reads1;         //!< the file of first parts of paired-end reads
+    std::string reads2;         //!< the file of second parts of paired-end reads
+    std::string samples_file;   //!< the manifest of samples
+    std::string output;         //!< the output directory, or the index file written by the **index** tool
+    int length;                 //!< the read length threshold
+    int polyG;                  //!< the length of poly-G and poly-C patterns
+    int polyA;                  //!< the length of poly-A and poly-T patterns
+    int dust_k;                 //!< the DUST algorithm parameter
+    int dust_cutoff;            //!< the DUST score threshold
+    int errors;                 //!< the number of errors between a read and a pattern
+    bool edit;                  //!< whether insertions and deletions are counted as errors
+    bool revcomp;               //!< whether patterns are searched on both read strands
+    int bloom_bits;             //!< the number of Bloom filter bits per k-mer
+    int window;                 //!< the minimizer window, 0 to search patterns
+    int minimizer_k;            //!< the minimizer length
+    int min_hits;               //!< the number of minimizers a matching read shares with patterns
+    bool verify;                //!< whether minimizer hits are verified
+    int compression;            //!< the compression level of output files, 0 for uncompressed files
+    int threads;                //!< the number of threads
+    bool unordered;             //!< whether reads may be written out of the input order
+};
+
+bool parse_options(int argc, char ** argv, int groups, Options & options, void (*print_help)());
+bool read_samples(Options const & options, std::vector <Sample> & samples);
+bool setup_library(Options const & options, Library & library, SharedIndex & shared_index);
+
+#endif // OPTIONS_H
@@ -0,0 +1,459 @@
+#include "pipeline.h"
+#include "readroutines.h"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <iostream>
+
+/*! \brief Copy records out of a reader buffer
+ *
+ *  Records of a reader which is not mapped become invalid when the reader
+ *  reads the next block, so the batches read ahead keep their own copy.
+ *
+ *  \param[in,out]  records     records of a single read() call, pointed to
+ *                              the copy afterwards
+ *  \param[out]     data        the copy
+ */
+static void keep_records(std::vector <FastqRecord> & records, std::string & data)
+{
+    if (records.empty()) {
+        data.clear();
+        return;
+    }
+    const char * first = records.front().id;
+    const char * last = records.back().qual + records.back().qual_size;
+    data.assign(first, last);
+    for (auto it = records.begin(); it != records.end(); ++it) {
+        it->id = data.data() + (it->id - first);
+        it->seq = data.data() + (it->seq - first);
+        it->qual = data.data() + (it->qual - first);
+    }
+}
+
+/*! \brief Read a batch of reads
+ *
+ *  \param[in]  reads1_f    a reader of single-end reads or of first parts of
+ *                          paired-end reads
+ *  \param[in]  reads2_f    a reader of second parts of paired-end reads or
+ *                          NULL for single-end reads
+ *  \param[out] batch       the batch
+ *  \param[in]  keep        whether the records must stay valid after the
+ *                          next batch is read
+ *  \return                 the number of reads or read pairs read
+ */
+static size_t read_batch(FastqReader & reads1_f, FastqReader * reads2_f, ReadBatch & batch, bool keep)
+{
+    if (reads2_f) {
+        batch.count = read_pairs(reads1_f, *reads2_f, batch.reads1, batch.reads2, read_batch_size);
+    } else {
+        batch.count = reads1_f.read(batch.reads1, read_batch_size);
+    }
+    if (keep && !reads1_f.mapped()) {
+        keep_records(batch.reads1, batch.data1);
+    }
+    if (keep && reads2_f && !reads2_f->mapped()) {
+        keep_records(batch.reads2, batch.data2);
+    }
+    return batch.count;
+}
+
+/*! \brief Count classified reads in the statistics of their batch
+ *
+ *  Both parts of a read pair are counted as paired-end reads if both of
+ *  them are left, and as single-end reads otherwise.
+ *
+ *  \param[in,out]  batch   the batch
+ */
+void count_reads(ReadBatch & batch)
+{
+    for (size_t i = 0; i < batch.count; ++i) {
+        if (batch.types2.empty()) {
+            batch.stats1.update(batch.types1[i]);
+            continue;
+        }
+        bool paired = batch.types1[i] == ReadType::ok && batch.types2[i] == ReadType::ok;
+        batch.stats1.update(batch.types1[i], paired);
+        batch.stats2.update(batch.types2[i], paired);
+    }
+}
+
+/*! \brief The number of classifying threads per sample processed at once by process_samples() */
+static const int threads_per_sample = 4;
+
+/*! \brief Start the threads of a pool
+ *
+ *  \param[in]  threads     the number of threads
+ *  \param[in]  pipelines   the number of pipelines using the pool at once
+ */
+ClassifierPool::ClassifierPool(int threads, int pipelines) : pipelines(std::max(pipelines, 1)), stopped(false)
+{
+    if (threads <= 1) {
+        return;
+    }
+    for (int i = 0; i < threads; ++i) {
+        workers.push_back(std::thread(&ClassifierPool::run, this));
+    }
+}
+
+/*! \brief Run the submitted jobs and stop the threads */
+ClassifierPool::~ClassifierPool()
+{
+    {
+        std::lock_guard <std::mutex> lock(mutex);
+        stopped = true;
+    }
+    work.notify_all();
+    for (auto it = workers.begin(); it != workers.end(); ++it) {
+        it->join();
+    }
+}
+
+/*! \brief Get the number of batches a pipeline using the pool keeps in flight
+ *
+ *  The pipelines sharing the pool get equal parts of the batches needed to
+ *  keep all threads busy.
+ *
+ *  \param[in]  ordered     whether the pipeline outputs batches in the input order
+ *  \return                 the number of batches
+ */
+size_t ClassifierPool::batches(bool ordered) const
+{
+    size_t threads = (workers.size() + pipelines - 1) / pipelines;
+    return ordered ? 2 * threads + 2 : threads + 2;
+}
+
+/*! \brief Get the number of threads a pipeline using the pool may spend on its files
+ *
+ *  The threads decompressing and compressing the files of a pipeline are
+ *  limited to its share of the pool, so the threads of all pipelines stay
+ *  within the number given by the user.
+ *
+ *  \return     the number of threads, at least one
+ */
+unsigned int ClassifierPool::share() const
+{
+    return std::max((workers.size() + pipelines - 1) / pipelines, (size_t)1);
+}
+
+/*! \brief Queue a job for a thread of the pool
+ *
+ *  \param[in]  job     the job
+ */
+void ClassifierPool::submit(Job const & job)
+{
+    std::lock_guard <std::mutex> lock(mutex);
+    jobs.push_back(job);
+    work.notify_one();
+}
+
+/*! \brief Run queued jobs until the pool is destroyed */
+void ClassifierPool::run()
+{
+    SearchWorkspace workspace;
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock <std::mutex> lock(mutex);
+            work.wait(lock, [this] { return stopped || !jobs.empty(); });
+            if (jobs.empty()) {
+                break;
+            }
+            job.swap(jobs.front());
+            jobs.pop_front();
+        }
+        job(workspace);
+    }
+}
+
+/*! \brief The state shared by the threads of classify_reads() */
+struct Pipeline
+{
+    std::vector <std::unique_ptr <ReadBatch> > pool;    //!< all batches
+    std::vector <ReadBatch *> free_batches;             //!< batches not in use
+    std::deque <ReadBatch *> ordered;                   //!< batches read, in the input order
+    bool finished;                                      //!< whether all reads were read
+    std::mutex mutex;                                   //!< the lock of the batch queues
+    std::mutex output_mutex;                            //!< the lock of the output in the unordered mode
+    std::condition_variable space;                      //!< notified when a batch is freed
+    std::condition_variable ready;                      //!< notified when a batch is classified or freed
+};
+
+/*! \brief The number of parts per classifying thread a mapped file is split into */
+static const size_t parts_per_thread = 4;
+
+/*! \brief Classify single-end reads of a mapped file in parts
+ *
+ *  The file is split into parts starting at record boundaries, and each
+ *  thread of the pool reads, classifies and counts the reads of a part on
+ *  its own, so no thread reads ahead for the others. There are several
+ *  parts per thread, so threads of a pool shared with other samples take
+ *  over the parts left when they are free. Calls of \p output are
+ *  serialized.
+ *
+ *  \param[in]  reads_f     a reader of a mapped file of single-end reads
+ *  \param[in]  library     a library of patterns used for string matching
+ *  \param[in]  length      the read length threshold
+ *  \param[in]  dust_k      the DUST algorithm parameter
+ *  \param[in]  dust_cutoff the DUST score threshold
+ *  \param[in]  pool        the classifying threads
+ *  \param[out] stats       statistics on the reads
+ *  \param[in]  output      the function writing classified reads
+ *  \param[in]  count       the function counting classified reads
+ */
+static void classify_parts(FastqReader & reads_f, Library const & library,
+                           unsigned int length, int dust_k, int dust_cutoff, ClassifierPool & pool,
+                           Stats & stats, BatchOutput const & output, BatchCounter const & count)
+{
+    std::vector <std::pair <size_t, size_t> > ranges;
+    reads_f.split(parts_per_thread * pool.size(), ranges);
+    size_t remaining = ranges.size();
+    std::mutex mutex;
+    std::mutex output_mutex;
+    std::condition_variable finished;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        pool.submit([&, i] (SearchWorkspace & workspace) {
+            FastqReader part(reads_f, ranges[i].first, ranges[i].second);
+            ReadBatch batch;
+            while (read_batch(part, NULL, batch, false) > 0) {
+                check_reads(batch.reads1, batch.count, library, length, dust_k, dust_cutoff, batch.types1, workspace);
+                count(batch);
+                std::lock_guard <std::mutex> output_lock(output_mutex);
+                output(batch);
+            }
+            std::lock_guard <std::mutex> lock(mutex);
+            stats.merge(batch.stats1);
+            if (--remaining == 0) {
+                finished.notify_one();
+            }
+        });
+    }
+    std::unique_lock <std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return remaining == 0; });
+}
+
+/*! \brief Classify reads and pass them to an output function
+ *
+ *  If the pool has threads, a reading thread fills batches of reads, the
+ *  threads of the pool classify them against the shared library, and the
+ *  calling thread passes the batches to \p output in the order they were
+ *  read, so the output is the same as with a single thread. The number of
+ *  batches in flight is limited by the pool.
+ *
+ *  If \p ordered is false, each classifying thread passes its batches to
+ *  \p output as soon as they are classified, so a slow batch does not hold
+ *  the others back and fewer batches are kept. Calls of \p output are still
+ *  serialized and get whole batches, so the parts of paired-end reads stay
+ *  together, but batches come in any order.
+ *
+ *  If \p ordered is false and single-end reads are read from a mapped file,
+ *  the file is split into parts classified by the threads of the pool
+ *  without a reading thread, see classify_parts(). Files of paired-end
+ *  reads are not split, as their parts could not be paired without reading
+ *  the records before them.
+ *
+ *  The reads are counted by \p count on the classifying threads in the
+ *  statistics of their batches, which are added to \p stats1 and \p stats2
+ *  when all reads are written.
+ *
+ *  \param[in]  reads1_f    a reader of single-end reads or of first parts of
+ *                          paired-end reads
+ *  \param[in]  reads2_f    a reader of second parts of paired-end reads or
+ *                          NULL for single-end reads
+ *  \param[in]  library     a library of patterns used for string matching
+ *  \param[in]  length      the read length threshold
+ *  \param[in]  dust_k      the DUST algorithm parameter
+ *  \param[in]  dust_cutoff the DUST score threshold
+ *  \param[in]  pool        the classifying threads
+ *  \param[in]  ordered     whether batches are output in the input order
+ *  \param[out] stats1      statistics on single-end reads or on first parts
+ *                          of paired-end reads
+ *  \param[out] stats2      statistics on second parts of paired-end reads or
+ *                          NULL for single-end reads
+ *  \param[in]  output      the function writing classified reads
+ *  \param[in]  count       the function counting classified reads, called by
+ *                          the classifying thread before \p output
+ */
+void classify_reads(FastqReader & reads1_f, FastqReader * reads2_f, Library const & library,
+                    unsigned int length, int dust_k, int dust_cutoff, ClassifierPool & pool, bool ordered,
+                    Stats & stats1, Stats * stats2, BatchOutput const & output, BatchCounter const & count)
+{
+    if (pool.size() == 0) {
+        ReadBatch batch;
+        SearchWorkspace workspace;
+        while (read_batch(reads1_f, reads2_f, batch, false) > 0) {
+            check_reads(batch.reads1, batch.count, library, length, dust_k, dust_cutoff, batch.types1, workspace);
+            if (reads2_f) {
+                check_reads(batch.reads2, batch.count, library, length, dust_k, dust_cutoff, batch.types2, workspace);
+            }
+            count(batch);
+            output(batch);
+        }
+        stats1.merge(batch.stats1);
+        if (stats2) {
+            stats2->merge(batch.stats2);
+        }
+        return;
+    }
+
+    if (!ordered && !reads2_f && reads1_f.mapped()) {
+        classify_parts(reads1_f, library, length, dust_k, dust_cutoff, pool, stats1, output, count);
+        return;
+    }
+
+    Pipeline pipeline;
+    pipeline.finished = false;
+    for (size_t i = 0; i < pool.batches(ordered); ++i) {
+        pipeline.pool.push_back(std::unique_ptr <ReadBatch> (new ReadBatch));
+        pipeline.free_batches.push_back(pipeline.pool.back().get());
+    }
+
+    auto classify = [&] (ReadBatch * batch, SearchWorkspace & workspace) {
+        check_reads(batch->reads1, batch->count, library, length, dust_k, dust_cutoff, batch->types1, workspace);
+        if (reads2_f) {
+            check_reads(batch->reads2, batch->count, library, length, dust_k, dust_cutoff, batch->types2, workspace);
+        }
+        count(*batch);
+        if (!ordered) {
+            {
+                std::lock_guard <std::mutex> output_lock(pipeline.output_mutex);
+                output(*batch);
+            }
+            std::lock_guard <std::mutex> lock(pipeline.mutex);
+            pipeline.free_batches.push_back(batch);
+            pipeline.space.notify_one();
+            pipeline.ready.notify_all();
+            return;
+        }
+        std::lock_guard <std::mutex> lock(pipeline.mutex);
+        batch->done = true;
+        pipeline.ready.notify_all();
+    };
+
+    std::thread reader([&] {
+        for (;;) {
+            ReadBatch * batch;
+            {
+                std::unique_lock <std::mutex> lock(pipeline.mutex);
+                pipeline.space.wait(lock, [&] { return !pipeline.free_batches.empty(); });
+                batch = pipeline.free_batches.back();
+                pipeline.free_batches.pop_back();
+            }
+            size_t count = read_batch(reads1_f, reads2_f, *batch, true);
+            std::lock_guard <std::mutex> lock(pipeline.mutex);
+            if (count == 0) {
+                pipeline.free_batches.push_back(batch);
+                pipeline.finished = true;
+                pipeline.ready.notify_all();
+                break;
+            }
+            batch->done = false;
+            if (ordered) {
+                pipeline.ordered.push_back(batch);
+            }
+            pool.submit([&classify, batch] (SearchWorkspace & workspace) { classify(batch, workspace); });
+        }
+    });
+
+    while (ordered) {
+        ReadBatch * batch;
+        {
+            std::unique_lock <std::mutex> lock(pipeline.mutex);
+            pipeline.ready.wait(lock, [&] {
+                return pipeline.ordered.empty() ? pipeline.finished : pipeline.ordered.front()->done;
+            });
+            if (pipeline.ordered.empty()) {
+                break;
+            }
+            batch = pipeline.ordered.front();
+            pipeline.ordered.pop_front();
+        }
+        output(*batch);
+        std::lock_guard <std::mutex> lock(pipeline.mutex);
+        pipeline.free_batches.push_back(batch);
+        pipeline.space.notify_one();
+    }
+
+    {
+        std::unique_lock <std::mutex> lock(pipeline.mutex);
+        pipeline.ready.wait(lock, [&] {
+            return pipeline.finished && pipeline.free_batches.size() == pipeline.pool.size();
+        });
+    }
+    reader.join();
+    for (auto it = pipeline.pool.begin(); it != pipeline.pool.end(); ++it) {
+        stats1.merge((*it)->stats1);
+        if (stats2) {
+            stats2->merge((*it)->stats2);
+        }
+    }
+}
+
+/*! \brief Process samples sharing a pool of classifying threads
+ *
+ *  Several samples are processed at once, one per \ref threads_per_sample
+ *  threads, and the largest samples are started first. All of them share
+ *  a pool of \p threads classifying threads, so when a sample is finished
+ *  or its reader falls behind, the threads classify reads of the others.
+ *  The reports on the samples are written to the standard output in the
+ *  order of the samples.
+ *
+ *  \param[in]  samples     the samples
+ *  \param[in]  threads     the number of classifying threads
+ *  \param[in]  process     the function processing a sample
+ *  \return                 \p true if all samples were processed successfully
+ */
+bool process_samples(std::vector <Sample> const & samples, int threads, SampleProcessor const & process)
+{
+    std::vector <size_t> order;
+    std::vector <size_t> sizes;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        order.push_back(i);
+        sizes.push_back(file_size(samples[i].reads) + file_size(samples[i].reads1) + file_size(samples[i].reads2));
+    }
+    std::stable_sort(order.begin(), order.end(), [&sizes] (size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    int jobs = std::max(1, std::min((int)samples.size(), (threads + threads_per_sample - 1) / threads_per_sample));
+    ClassifierPool pool(threads, jobs);
+
+    std::vector <std::string> reports(samples.size());
+    std::vector <bool> finished(samples.size(), false);
+    size_t next = 0;
+    size_t printed = 0;
+    bool success = true;
+    std::mutex mutex;
+
+    auto run = [&] {
+        for (;;) {
+            size_t sample;
+            {
+                std::lock_guard <std::mutex> lock(mutex);
+                if (next == order.size()) {
+                    break;
+                }
+                sample = order[next++];
+            }
+            std::ostringstream report;
+            bool result = process(samples[sample], pool, report);
+            std::lock_guard <std::mutex> lock(mutex);
+            success = success && result;
+            reports[sample] = report.str();
+            finished[sample] = true;
+            for (; printed < samples.size() && finished[printed]; ++printed) {
+                std::cout << reports[printed];
+                reports[printed].clear();
+            }
+            std::cout.flush();
+        }
+    };
+
+    std::vector <std::thread> drivers;
+    for (int i = 1; i < jobs; ++i) {
+        drivers.push_back(std::thread(run));
+    }
+    run();
+    for (auto it = drivers.begin(); it != drivers.end(); ++it) {
+        it->join();
+    }
+    return success;
+}
@@ -0,0 +1,97 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+#include "fastq.h"
+#include "fileroutines.h"
+#include "library.h"
+#include "seq.h"
+#include "stats.h"
+
+/*! \brief A batch of reads classified together
+ *
+ *  The statistics of a batch are kept while it is reused for the next
+ *  reads, so the thread classifying a batch counts its reads without a
+ *  lock, and the counts of all batches are merged once per file.
+ */
+struct ReadBatch
+{
+    std::vector <FastqRecord> reads1;   //!< single-end reads or first parts of paired-end reads
+    std::vector <FastqRecord> reads2;   //!< second parts of paired-end reads
+    std::vector <ReadType> types1;      //!< the types of ReadBatch::reads1
+    std::vector <ReadType> types2;      //!< the types of ReadBatch::reads2
+    std::string data1;                  //!< the copy of ReadBatch::reads1 unless they are in a mapped file
+    std::string data2;                  //!< the copy of ReadBatch::reads2 unless they are in a mapped file
+    Stats stats1;                       //!< the counts of all reads held by the batch as ReadBatch::reads1
+    Stats stats2;                       //!< the counts of all reads held by the batch as ReadBatch::reads2
+    size_t count;                       //!< the number of reads or read pairs
+    bool done;                          //!< whether the reads were classified
+};
+
+/*! \brief A function writing a classified batch of reads */
+typedef std::function <void (ReadBatch const &)> BatchOutput;
+
+/*! \brief A function counting a classified batch of reads in its statistics */
+typedef std::function <void (ReadBatch &)> BatchCounter;
+
+/*! \brief A pool of threads classifying batches of reads
+ *
+ *  The pool may be shared by several pipelines reading different files,
+ *  and its threads take the batches of all of them from a single queue,
+ *  so a thread having nothing to do for one file works for another. A
+ *  pool of a single thread starts no threads, and pipelines using it
+ *  classify reads on the calling thread.
+ */
+class ClassifierPool
+{
+public:
+    /*! \brief A job run by a thread of the pool with its own search workspace */
+    typedef std::function <void (SearchWorkspace &)> Job;
+
+    ClassifierPool(int threads, int pipelines = 1);
+    ~ClassifierPool();
+
+    /*! \brief Get the number of threads of the pool
+     *
+     *  \return     the number of threads, zero for a pool of a single thread
+     */
+    size_t size() const { return workers.size(); }
+
+    size_t batches(bool ordered) const;
+    unsigned int share() const;
+    void submit(Job const & job);
+
+private:
+    ClassifierPool(ClassifierPool const &) = delete;
+    ClassifierPool & operator = (ClassifierPool const &) = delete;
+
+    void run();
+
+    std::vector <std::thread> workers;  //!< the threads
+    std::deque <Job> jobs;              //!< jobs waiting for a thread
+    int pipelines;                      //!< the number of pipelines using the pool at once
+    bool stopped;                       //!< whether the threads should quit
+    std::mutex mutex;                   //!< the lock of the job queue
+    std::condition_variable work;       //!< notified when a job is submitted
+};
+
+/*! \brief A function processing a sample with a shared pool and writing a report on it */
+typedef std::function <bool (Sample const &, ClassifierPool &, std::ostream &)> SampleProcessor;
+
+void count_reads(ReadBatch & batch);
+void classify_reads(FastqReader & reads1_f, FastqReader * reads2_f, Library const & library,
+                    unsigned int length, int dust_k, int dust_cutoff, ClassifierPool & pool, bool ordered,
+                    Stats & stats1, Stats * stats2, BatchOutput const & output,
+                    BatchCounter const & count = count_reads);
+bool process_samples(std::vector <Sample> const & samples, int threads, SampleProcessor const & process);
+
+#endif // PIPELINE_H
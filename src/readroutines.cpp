@@ -1,12 +1,86 @@
 #include "readroutines.h"
 #include <cmath>
+#include <algorithm>
+#include <functional>
 #include <unordered_map>
 
+/*! \brief The size of a memory block of DUST hash tables */
+static const size_t dust_block_size = 1 << 16;
+
+/*! \brief Take memory for a DUST hash table from a workspace
+ *
+ *  \param[in,out]  workspace   the workspace keeping memory blocks
+ *  \param[in]      size        the number of bytes
+ *  \return                     the memory aligned to 16 bytes
+ */
+static void * allocate_dust(SearchWorkspace & workspace, size_t size)
+{
+    size = (size + 15) & ~(size_t)15;
+    while (workspace.block < workspace.blocks.size() &&
+            workspace.used + size > workspace.blocks[workspace.block].size()) {
+        ++workspace.block;
+        workspace.used = 0;
+    }
+    if (workspace.block == workspace.blocks.size()) {
+        workspace.blocks.push_back(std::vector <char> (std::max(size, dust_block_size)));
+    }
+    void * memory = workspace.blocks[workspace.block].data() + workspace.used;
+    workspace.used += size;
+    return memory;
+}
+
+/*! \brief An allocator taking memory of a DUST hash table from a workspace
+ *
+ *  Memory is never released to the allocator; it is reused for the table of
+ *  the next read, so computing scores allocates no memory once the
+ *  workspace has grown.
+ */
+template <class T>
+struct DustAllocator
+{
+    typedef T value_type;
+
+    /*! \brief The allocator of another type */
+    template <class U>
+    struct rebind
+    {
+        typedef DustAllocator <U> other;
+    };
+
+    DustAllocator(SearchWorkspace & workspace) : workspace(&workspace) {}
+
+    template <class U>
+    DustAllocator(DustAllocator <U> const & other) : workspace(other.workspace) {}
+
+    T * allocate(size_t count)
+    {
+        return static_cast <T *> (allocate_dust(*workspace, count * sizeof(T)));
+    }
+
+    void deallocate(T *, size_t) {}
+
+    template <class U>
+    bool operator == (DustAllocator <U> const & other) const
+    {
+        return workspace == other.workspace;
+    }
+
+    template <class U>
+    bool operator != (DustAllocator <U> const & other) const
+    {
+        return workspace != other.workspace;
+    }
+
+    SearchWorkspace * workspace;    //!< the workspace keeping the memory
+};
+
 /*! \brief Given a read sequence, calculate its DUST score
  *
- *  \param[in]  read    a read sequence
- *  \param[in]  k       the DUST algorithm parameter
- *  \return             the DUST score
+ *  \param[in]      read        a read sequence converted to base codes by
+ *                              normalize_bases()
+ *  \param[in]      k           the DUST algorithm parameter
+ *  \param[in,out]  workspace   buffers for the hash table of k-mer counts
+ *  \return                     the DUST score
  *
  *  \remark For more information on the DUST score, please check the following
  *  paper:
@@ -14,19 +88,18 @@
  *  Agarwala. "A fast and symmetric DUST implementation to mask low-complexity
  *  DNA sequences." *Journal of Computational Biology* 13, no. 5 (2006): 1028-1040.
  */
-double get_dust_score(std::string const & read, int k)
+double get_dust_score(std::string const & read, int k, SearchWorkspace & workspace)
 {
-    std::unordered_map <int, int> counts;
-    static std::unordered_map <char, int> hashes = {{'N', 1},
-        {'A', 2},
-        {'C', 3},
-        {'G', 4},
-        {'T', 5}};
+    typedef DustAllocator <std::pair <const int, int> > Allocator;
+    workspace.block = 0;
+    workspace.used = 0;
+    std::unordered_map <int, int, std::hash <int>, std::equal_to <int>, Allocator> counts(
+        0, std::hash <int>(), std::equal_to <int>(), Allocator(workspace));
+    static const int digits[Automaton::sigma] = {2, 3, 4, 5, 1, 0};
     unsigned int hash = 0;
     unsigned int max_pow = pow(10, k - 1);
     for (auto it = read.begin(); it != read.end(); ++it) {
-        char c = (*it > 96) ? (*it - 32) : *it;
-        hash = hash * 10 + hashes[c];
+        hash = hash * 10 + digits[(unsigned char)*it];
         if (it - read.begin() >= k - 1) {
             ++counts[hash];
             hash = hash - (hash / max_pow) * max_pow;
@@ -42,31 +115,77 @@ double get_dust_score(std::string const & read, int k)
     return (total / (read.size() - k + 1));
 }
 
-/*! \brief Check a read against patterns
+/*! \brief Apply the length and DUST filters to a batch of reads
  *
- *  \param[in]  read        a read sequence
- *  \param[in]  root        a root of the trie structure used for string matching
- *  \param[in]  patterns    a vector of patterns
- *  \param[in]  length      the read length threshold
- *  \param[in]  dust_k      the DUST algorithm parameter
- *  \param[in]  dust_cutoff the DUST score threshold
- *  \param[in]  errors      the number of resolved mismatches between a read and
- *                          a pattern
- *  \return                 the read type
+ *  \tparam     check_length    whether the length filter is enabled
+ *  \tparam     check_dust      whether the DUST filter is enabled
+ *  \param[in]      reads       reads
+ *  \param[in]      count       the number of reads to check
+ *  \param[in]      length      the read length threshold
+ *  \param[in]      dust_k      the DUST algorithm parameter
+ *  \param[in]      dust_cutoff the DUST score threshold
+ *  \param[out]     types       the types of reads filtered out
+ *  \param[in,out]  workspace   buffers to put base codes of the other reads to
  */
-ReadType check_read(std::string const & read, Node * root, std::vector <std::pair<std::string, Node::Type> > const & patterns,
-                    unsigned int length, int dust_k, int dust_cutoff, int errors)
+template <bool check_length, bool check_dust>
+static void filter_reads(std::vector <FastqRecord> const & reads, size_t count,
+                         unsigned int length, int dust_k, int dust_cutoff,
+                         std::vector <ReadType> & types, SearchWorkspace & workspace)
 {
-    if (length && read.size() < length) {
-        return ReadType::length;
+    for (size_t i = 0; i < count; ++i) {
+        if (check_length && reads[i].seq_size < length) {
+            types[i] = ReadType::length;
+            continue;
+        }
+        std::string & codes = workspace.codes[i];
+        normalize_bases(reads[i].seq, reads[i].seq_size, codes);
+        if (check_dust && get_dust_score(codes, dust_k, workspace) > dust_cutoff) {
+            types[i] = ReadType::dust;
+        } else {
+            workspace.texts.push_back(&codes);
+            workspace.indices.push_back(i);
+        }
     }
-    if (dust_cutoff && get_dust_score(read, dust_k) > dust_cutoff) {
-        return ReadType::dust;
+}
+
+/*! \brief Check a batch of reads against patterns
+ *
+ *  Reads passing the length and DUST filters are searched for patterns
+ *  together. The filter loop is instantiated for each combination of
+ *  enabled filters, so disabled filters cost nothing.
+ *
+ *  \param[in]      reads       reads
+ *  \param[in]      count       the number of reads to check
+ *  \param[in]      library     a library of patterns used for string matching
+ *  \param[in]      length      the read length threshold
+ *  \param[in]      dust_k      the DUST algorithm parameter
+ *  \param[in]      dust_cutoff the DUST score threshold
+ *  \param[out]     types       the read types
+ *  \param[in,out]  workspace   buffers reused between batches
+ */
+void check_reads(std::vector <FastqRecord> const & reads, size_t count, Library const & library,
+                 unsigned int length, int dust_k, int dust_cutoff,
+                 std::vector <ReadType> & types, SearchWorkspace & workspace)
+{
+    workspace.texts.clear();
+    workspace.indices.clear();
+    if (workspace.codes.size() < count) {
+        workspace.codes.resize(count);
     }
-    
-    if (errors) {
-        return (ReadType)search_inexact(read, root, patterns, errors);
+    types.resize(count);
+    if (length && dust_cutoff) {
+        filter_reads <true, true> (reads, count, length, dust_k, dust_cutoff, types, workspace);
+    } else if (length) {
+        filter_reads <true, false> (reads, count, length, dust_k, dust_cutoff, types, workspace);
+    } else if (dust_cutoff) {
+        filter_reads <false, true> (reads, count, length, dust_k, dust_cutoff, types, workspace);
     } else {
-        return (ReadType)search_any(read, root);
+        filter_reads <false, false> (reads, count, length, dust_k, dust_cutoff, types, workspace);
+    }
+    std::vector <size_t> const & indices = workspace.indices;
+    workspace.types.resize(indices.size());
+    library.search_normalized(workspace.texts.data(), indices.size(), workspace.types.data(), workspace);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        types[indices[i]] = (ReadType)workspace.types[i];
     }
 }
@@ -3,14 +3,20 @@
 
 #include <string>
 #include <vector>
+#include <fstream>
 #include <utility>
 
+#include "fastq.h"
+#include "library.h"
 #include "search.h"
 #include "seq.h"
 
-double get_dust_score(std::string const & read, int k);
-ReadType check_read(std::string const & read, Node * root,
-                    std::vector <std::pair<std::string, Node::Type> > const & patterns,
-                    unsigned int length, int dust_k, int dust_cutoff, int errors);
+/*! \brief The number of reads classified together by check_reads() */
+const size_t read_batch_size = 1024;
+
+double get_dust_score(std::string const & read, int k, SearchWorkspace & workspace);
+void check_reads(std::vector <FastqRecord> const & reads, size_t count, Library const & library,
+                 unsigned int length, int dust_k, int dust_cutoff,
+                 std::vector <ReadType> & types, SearchWorkspace & workspace);
 
 #endif // READROUTINES_H
@@ -6,76 +6,49 @@
 #include <map>
 #include <algorithm>
 #include <locale>
-#include <getopt.h>
 #include <stdlib.h>
 #include <unordered_map>
 
+#include "fastq.h"
 #include "fileroutines.h"
+#include "library.h"
+#include "options.h"
+#include "pipeline.h"
 #include "readroutines.h"
 #include "search.h"
 #include "stats.h"
 #include "seq.h"
+#include "sharedindex.h"
 #include "version.h"
 
-/*! \brief Read adapter patterns from an input stream
- *
- *  \param[in]  kmers_f     an input stream to read the patterns from
- *  \param[in]  polyG       the length of poly-G and poly-C patterns
- *  \param[out] patterns    the vector to which the patterns are written
- */
-void build_patterns(std::ifstream & kmers_f, int polyG, std::vector <std::pair <std::string, Node::Type> > & patterns)
-{
-    std::string tmp;
-    while (!kmers_f.eof()) {
-        std::getline(kmers_f, tmp);
-        std::transform(tmp.begin(), tmp.end(), tmp.begin(), ::toupper);
-        if (!tmp.empty()) {
-            size_t tab = tmp.find('\t');
-            if (tab == std::string::npos) {
-                patterns.push_back(std::make_pair(tmp, Node::Type::adapter));
-            } else {
-                patterns.push_back(std::make_pair(tmp.substr(0, tab), Node::Type::adapter));
-            }
-        }
-    }
-    kmers_f.close();
-    patterns.push_back(std::make_pair("NN", Node::Type::n));
-    if (polyG) {
-        patterns.push_back(std::make_pair(std::string(polyG, 'G'), Node::Type::polyG));
-        patterns.push_back(std::make_pair(std::string(polyG, 'C'), Node::Type::polyC));
-    }
-}
-
 /*! \brief Filter single-end reads by patterns
  *
  *  \param[in]  reads_f     an input stream of read sequences
  *  \param[out] ok_f        an output stream of filtered reads
  *  \param[out] bad_f       an output stream of reads filtered out
  *  \param[out] stats       statistics on processed reads
- *  \param[out] root        a root of the trie structure used to perform string matching
- *  \param[in]  patterns    a vector of patterns for read filtration
+ *  \param[in]  library     a library of patterns for read filtration
  *  \param[in]  length      the read length threshold
  *  \param[in]  dust_k      the DUST algorithm parameter
  *  \param[in]  dust_cutoff the DUST score threshold
- *  \param[in]  errors      the number of resolved mismatches between a read and
- *                          a pattern
+ *  \param[in]  pool        the classifying threads
+ *  \param[in]  ordered     whether reads are written in the input order
  */
-void filter_single_reads(std::ifstream & reads_f, std::ofstream & ok_f, std::ofstream & bad_f, 
-                         Stats & stats, Node * root, std::vector <std::pair<std::string, Node::Type> > const & patterns,
-                         int length, int dust_k, int dust_cutoff, int errors)
+void filter_single_reads(FastqReader & reads_f, FastqWriter & ok_f, FastqWriter & bad_f, 
+                         Stats & stats, Library const & library,
+                         int length, int dust_k, int dust_cutoff, ClassifierPool & pool, bool ordered)
 {
-    Seq read;
-
-    while (read.read_seq(reads_f)) {
-        ReadType type = check_read(read.seq, root, patterns, length, dust_k, dust_cutoff, errors);
-        stats.update(type);
-        if (type == ReadType::ok) {
-            read.write_seq(ok_f);
-        } else {
-            read.update_id(type);
-            read.write_seq(bad_f);
+    classify_reads(reads_f, NULL, library, length, dust_k, dust_cutoff, pool, ordered, stats, NULL, [&](ReadBatch const & batch) {
+        for (size_t i = 0; i < batch.count; ++i) {
+            FastqRecord const & read = batch.reads1[i];
+            ReadType type = batch.types1[i];
+            if (type == ReadType::ok) {
+                write_record(ok_f, read);
+            } else {
+                write_record(bad_f, read, type);
+            }
         }
-    }
+    });
 }
 
 /*! \brief Filter paired-end reads by patterns
@@ -90,237 +63,152 @@ void filter_single_reads(std::ifstream & reads_f, std::ofstream & ok_f, std::ofs
  *  \param[out] se2_f       an output stream to write filtered second parts of paired-end reads
  *  \param[out] stats1      statistics on first parts of processed reads
  *  \param[out] stats2      statistics on second parts of processed reads
- *  \param[in]  root        a root of the trie structure used to perform string matching
- *  \param[in]  patterns    a vector of patterns for read filtration
+ *  \param[in]  library     a library of patterns for read filtration
  *  \param[in]  length      the read length threshold
  *  \param[in]  dust_k      the DUST algorithm parameter
  *  \param[in]  dust_cutoff the DUST score threshold
- *  \param[in]  errors      the number of resolved mismatches between a read and
- *                          a pattern
+ *  \param[in]  pool        the classifying threads
+ *  \param[in]  ordered     whether reads are written in the input order
  *
  *  \remark The streams \p se1_f (and \p se2_f) correspond to paired-end reads which second
  *  (or first) part was filtered but the other one was left.
  */
-void filter_paired_reads(std::ifstream & reads1_f, std::ifstream & reads2_f,
-                         std::ofstream & ok1_f, std::ofstream & ok2_f,
-                         std::ofstream & bad1_f, std::ofstream & bad2_f,
-                         std::ofstream & se1_f, std::ofstream & se2_f,
+void filter_paired_reads(FastqReader & reads1_f, FastqReader & reads2_f,
+                         FastqWriter & ok1_f, FastqWriter & ok2_f,
+                         FastqWriter & bad1_f, FastqWriter & bad2_f,
+                         FastqWriter & se1_f, FastqWriter & se2_f,
                          Stats & stats1, Stats & stats2,
-                         Node * root, std::vector <std::pair<std::string, Node::Type> > const & patterns,
-                         int length, int dust_k, int dust_cutoff, int errors)
+                         Library const & library,
+                         int length, int dust_k, int dust_cutoff, ClassifierPool & pool, bool ordered)
 {
-    Seq read1;
-    Seq read2;
-
-    while (read1.read_seq(reads1_f) && read2.read_seq(reads2_f)) {
-        ReadType type1 = check_read(read1.seq, root, patterns, length, dust_k, dust_cutoff, errors);
-        ReadType type2 = check_read(read2.seq, root, patterns, length, dust_k, dust_cutoff, errors);
-        if (type1 == ReadType::ok && type2 == ReadType::ok) {
-            read1.write_seq(ok1_f);
-            read2.write_seq(ok2_f);
-            stats1.update(type1, true);
-            stats2.update(type2, true);
-        } else {
-            stats1.update(type1, false);
-            stats2.update(type2, false);
-            if (type1 == ReadType::ok) {
-                read1.write_seq(se1_f);
-                read2.update_id(type2);
-                read2.write_seq(bad2_f);
-            } else if (type2 == ReadType::ok) { 
-                read1.update_id(type1);
-                read1.write_seq(bad1_f);
-                read2.write_seq(se2_f);
+    classify_reads(reads1_f, &reads2_f, library, length, dust_k, dust_cutoff, pool, ordered, stats1, &stats2, [&](ReadBatch const & batch) {
+        for (size_t i = 0; i < batch.count; ++i) {
+            FastqRecord const & read1 = batch.reads1[i];
+            FastqRecord const & read2 = batch.reads2[i];
+            ReadType type1 = batch.types1[i];
+            ReadType type2 = batch.types2[i];
+            if (type1 == ReadType::ok && type2 == ReadType::ok) {
+                write_record(ok1_f, read1);
+                write_record(ok2_f, read2);
             } else {
-                read1.update_id(type1);
-                read2.update_id(type2);
-                read1.write_seq(bad1_f);
-                read2.write_seq(bad2_f);
+                if (type1 == ReadType::ok) {
+                    write_record(se1_f, read1);
+                    write_record(bad2_f, read2, type2);
+                } else if (type2 == ReadType::ok) { 
+                    write_record(bad1_f, read1, type1);
+                    write_record(se2_f, read2);
+                } else {
+                    write_record(bad1_f, read1, type1);
+                    write_record(bad2_f, read2, type2);
+                }
             }
         }
-    }
+    });
 }
 
 /*! \brief Print program parameters */
 void print_help() 
 {
     std::cerr << "Usage:" << std::endl;
-    std::cerr << "rm_reads [-i raw_data.fastq | -1 raw_data1.fastq -2 raw_data2.fastq] -o output_dir --polyG 13 --length 50 --fragments fragments.dat --dust_cutoff cutoff --dust_k k" << std::endl;
+    std::cerr << "rm_reads [-i raw_data.fastq | -1 raw_data1.fastq -2 raw_data2.fastq | --samples samples.txt] -o output_dir --polyG 13 [--polyat 20] --length 50 [--fragments fragments.dat [--shared /dev/shm] | --index library.idx] --dust_cutoff cutoff --dust_k k [--revcomp] [--errors 1] [--edit_distance] [--bloom 10] [--window 10 [--minimizer_k 21] [--min_hits 1] [--verify]] [--compress 6] [--threads 4 [--unordered]]" << std::endl;
 	show_version();
 }
 
-/*! \brief The main function of the **rm_reads** tool. */
-int main(int argc, char ** argv)
+/*! \brief Filter reads of a sample and write them to the output directory
+ *
+ *  \param[in]  sample      the files of single-end or paired-end reads
+ *  \param[in]  out_dir     the output directory
+ *  \param[in]  compression the compression level of output files, 0 for uncompressed files
+ *  \param[in]  library     a library of patterns for read filtration
+ *  \param[in]  length      the read length threshold
+ *  \param[in]  dust_k      the DUST algorithm parameter
+ *  \param[in]  dust_cutoff the DUST score threshold
+ *  \param[in]  pool        the classifying threads
+ *  \param[in]  ordered     whether reads are written in the input order
+ *  \param[out] report      the stream to write statistics on the reads to
+ *  \return                 \p true if the reads were filtered, \p false if a file cannot be
+ *                          opened or read
+ */
+bool filter_sample(Sample const & sample, std::string const & out_dir, int compression,
+                   Library const & library,
+                   int length, int dust_k, int dust_cutoff,
+                   ClassifierPool & pool, bool ordered, std::ostream & report)
 {
-    Node root('0');
-    std::vector <std::pair<std::string, Node::Type> > patterns;
-
-    std::string kmers, reads, out_dir;
-    std::string reads1, reads2;
-    char rez = 0;
-    int length = 0;
-    int polyG = 0;
-    int dust_k = 4;
-    int dust_cutoff = 0;
-    int errors = 0;
+    std::string extension = compression ? ".fastq.gz" : ".fastq";
+    BgzfPool compressor(pool.share());
 
-    const struct option long_options[] = {
-        {"length",required_argument,NULL,'l'},
-        {"polygc",required_argument,NULL,'p'},
-        {"fragments",required_argument,NULL,'f'},
-        {"dust_k",required_argument,NULL,'k'},
-        {"dust_cutoff",required_argument,NULL,'c'},
-        {NULL,0,NULL,0}
-    };
-
-    while ((rez = getopt_long(argc, argv, "1:2:l:p:f:i:o:c:k:", long_options, NULL)) != -1) {
-        switch (rez) {
-        case 'l':
-            length = std::atoi(optarg);
-            break;
-        case 'p':
-            polyG = std::atoi(optarg);
-            // polyG = boost::lexical_cast<int>(optarg);
-            break;
-        case 'f':
-            kmers = optarg;
-            break;
-        case 'i':
-            reads = optarg;
-            break;
-        case '1':
-            reads1 = optarg;
-            break;
-        case '2':
-            reads2 = optarg;
-            break;
-        case 'o':
-            out_dir = optarg;
-            break;
-        case 'c':
-            dust_cutoff = std::atoi(optarg);
-            break;
-        case 'k':
-            dust_k = std::atoi(optarg);
-            break;
-        case '?':
-            print_help();
-            return -1;
-        }
-    }
-
-    if (errors < 0 || errors > 2) {
-        std::cerr << "possible errors count are 0, 1, 2" << std::endl;
-        return -1;
-    }
-
-    if (kmers.empty() || out_dir.empty() || (
-            reads.empty() &&
-            (reads1.empty() || reads2.empty()))) {
-        print_help();
-        return -1;
-    }
-    
-    if (!verify_directory(out_dir)) {
-        std::cerr << "Output directory does not exist, failed to create" << std::endl;
-        return -1;
-    }
-
-    std::ifstream kmers_f (kmers.c_str());
-    if (!kmers_f.good()) {
-        std::cerr << "Cannot open kmers file" << std::endl;
-        print_help();
-        return -1;
-    }
-
-    init_type_names(length, polyG, dust_k, dust_cutoff);
-
-    std::cerr << "Building patterns..." << std::endl;
-    build_patterns(kmers_f, polyG, patterns);
-
-    /*
-    for (std::vector <std::string> ::iterator it = patterns.begin(); it != patterns.end(); ++it) {
-        std::cout << *it << std::endl;
-    }
-    */
-
-    if (patterns.empty()) {
-        std::cerr << "patterns are empty" << std::endl;
-        return -1;
-    }
-
-    std::cerr << "Building trie..." << std::endl;
-    build_trie(root, patterns, errors);
-	add_failures(root);
-
-    if (!reads.empty()) {
-        std::string reads_base = basename(reads);
-        std::ifstream reads_f (reads.c_str());
-        std::ofstream ok_f((out_dir + "/" + reads_base + ".ok.fastq").c_str(), std::ofstream::out);
-        std::ofstream bad_f((out_dir + "/" + reads_base + ".filtered.fastq").c_str(), std::ofstream::out);
+    if (!sample.reads.empty()) {
+        std::string reads_base = basename(sample.reads);
+        FastqReader reads_f(sample.reads, pool.share());
+        FastqWriter ok_f(out_dir + "/" + reads_base + ".ok" + extension, compression, compressor);
+        FastqWriter bad_f(out_dir + "/" + reads_base + ".filtered" + extension, compression, compressor);
 
         if (!reads_f.good()) {
             std::cerr << "Cannot open reads file" << std::endl;
             print_help();
-            return -1;
+            return false;
         }
 
         if (!ok_f.good() || !bad_f.good()) {
             std::cerr << "Cannot open output file" << std::endl;
             print_help();
-            return -1;
+            return false;
         }
 
-        Stats stats(reads);
+        Stats stats(sample.reads);
 
-        filter_single_reads(reads_f, ok_f, bad_f, stats, &root, patterns, length, dust_k, dust_cutoff, errors);
+        filter_single_reads(reads_f, ok_f, bad_f, stats, library, length, dust_k, dust_cutoff, pool, ordered);
 
-        std::cout << stats;
+        if (!reads_f.good()) {
+            std::cerr << "Cannot read reads file" << std::endl;
+            return false;
+        }
+
+        report << stats;
 
         ok_f.close();
         bad_f.close();
         reads_f.close();
     } else {
-        std::string reads1_base = basename(reads1);
-        std::string reads2_base = basename(reads2);
-        std::ifstream reads1_f(reads1.c_str());
-        std::ifstream reads2_f(reads2.c_str());
-        std::ofstream ok1_f((out_dir + "/" + reads1_base + ".ok.fastq").c_str(),
-                            std::ofstream::out);
-        std::ofstream ok2_f((out_dir + "/" + reads2_base + ".ok.fastq").c_str(),
-                            std::ofstream::out);
-        std::ofstream se1_f((out_dir + "/" + reads1_base + ".se.fastq").c_str(),
-                            std::ofstream::out);
-        std::ofstream se2_f((out_dir + "/" + reads2_base + ".se.fastq").c_str(),
-                            std::ofstream::out);
-        std::ofstream bad1_f((out_dir + "/" + reads1_base + ".filtered.fastq").c_str(),
-                            std::ofstream::out);
-        std::ofstream bad2_f((out_dir + "/" + reads2_base + ".filtered.fastq").c_str(),
-                            std::ofstream::out);
+        std::string reads1_base = basename(sample.reads1);
+        std::string reads2_base = basename(sample.reads2);
+        FastqReader reads1_f(sample.reads1, (pool.share() + 1) / 2);
+        FastqReader reads2_f(sample.reads2, (pool.share() + 1) / 2);
+        FastqWriter ok1_f(out_dir + "/" + reads1_base + ".ok" + extension, compression, compressor);
+        FastqWriter ok2_f(out_dir + "/" + reads2_base + ".ok" + extension, compression, compressor);
+        FastqWriter se1_f(out_dir + "/" + reads1_base + ".se" + extension, compression, compressor);
+        FastqWriter se2_f(out_dir + "/" + reads2_base + ".se" + extension, compression, compressor);
+        FastqWriter bad1_f(out_dir + "/" + reads1_base + ".filtered" + extension, compression, compressor);
+        FastqWriter bad2_f(out_dir + "/" + reads2_base + ".filtered" + extension, compression, compressor);
 
         if (!reads1_f.good() || !reads2_f.good()) {
             std::cerr << "reads file is bad" << std::endl;
             print_help();
-            return -1;
+            return false;
         }
 
         if (!ok1_f.good() || !ok2_f.good() || !bad1_f.good() || !bad2_f.good() ||
                 !se1_f.good() || !se2_f.good()) {
             std::cerr << "out file is bad" << std::endl;
             print_help();
-            return -1;
+            return false;
         }
 
-        Stats stats1(reads1);
-        Stats stats2(reads2);
+        Stats stats1(sample.reads1);
+        Stats stats2(sample.reads2);
 
         filter_paired_reads(reads1_f, reads2_f, ok1_f, ok2_f,
                             bad1_f, bad2_f, se1_f, se2_f,
                             stats1, stats2,
-                            &root, patterns, length, dust_k, dust_cutoff, errors);
+                            library, length, dust_k, dust_cutoff, pool, ordered);
 
-        std::cout << stats1;
-        std::cout << stats2;
+        if (!reads1_f.good() || !reads2_f.good()) {
+            std::cerr << "Cannot read reads file" << std::endl;
+            return false;
+        }
+
+        report << stats1;
+        report << stats2;
 
         ok1_f.close();
         ok2_f.close();
@@ -330,5 +218,40 @@ int main(int argc, char ** argv)
         reads2_f.close();
     }
 
-    return 0;
+    return true;
+}
+
+/*! \brief The main function of the **rm_reads** tool. */
+int main(int argc, char ** argv)
+{
+    Options options;
+    int groups = input_options | single_options | filter_options | output_options | index_options;
+    if (!parse_options(argc, argv, groups, options, print_help)) {
+        return -1;
+    }
+
+    std::vector <Sample> samples;
+    if (!read_samples(options, samples)) {
+        return -1;
+    }
+
+    if (!verify_directory(options.output)) {
+        std::cerr << "Output directory does not exist, failed to create" << std::endl;
+        return -1;
+    }
+
+    init_type_names(options.length, options.polyG, options.dust_k, options.dust_cutoff, options.polyA);
+
+    Library library;
+    SharedIndex shared_index;
+    if (!setup_library(options, library, shared_index)) {
+        return -1;
+    }
+
+    bool success = process_samples(samples, options.threads, [&](Sample const & sample, ClassifierPool & pool, std::ostream & report) {
+        return filter_sample(sample, options.output, options.compression, library, options.length, options.dust_k, options.dust_cutoff,
+                             pool, !options.unordered, report);
+    });
+
+    return success ? 0 : -1;
 }
@@ -0,0 +1,179 @@
+#include "runset.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+const size_t RunSet::max_runs;
+const size_t RunSet::block_size;
+
+/*! \brief Add a homopolymer pattern to the matcher
+ *
+ *  \param[in]  pattern     a pattern in upper case
+ *  \param[in]  type        the type of the pattern
+ *  \return                 whether the pattern was added; patterns which
+ *                          are not runs of A, C, G, T or N and patterns
+ *                          beyond RunSet::max_runs are not added
+ */
+bool RunSet::add(std::string const & pattern, Node::Type type)
+{
+    if (pattern.empty() || runs.size() >= max_runs || base_code(pattern[0]) > 4 ||
+            pattern.find_first_not_of(pattern[0]) != std::string::npos) {
+        return false;
+    }
+    Run run = {pattern[0], pattern.size(), type};
+    runs.push_back(run);
+    size_t slot = bases.find(base_code(pattern[0]));
+    if (slot == std::string::npos) {
+        slot = bases.size();
+        bases.push_back(base_code(pattern[0]));
+    }
+    slots.push_back(slot);
+    return true;
+}
+
+/*! \brief Remove all runs from the matcher */
+void RunSet::clear()
+{
+    runs.clear();
+    bases.clear();
+    slots.clear();
+}
+
+/*! \brief Get masks of block positions holding bases
+ *
+ *  Each part of the block is loaded once and compared to all bases with
+ *  AVX2 or SSE2 instructions if the compiler targets them.
+ *
+ *  \param[in]  block   RunSet::block_size base codes
+ *  \param[in]  bases   codes of bases
+ *  \param[out] masks   masks with bit i set if code i is the base, one for
+ *                      each base
+ */
+static inline void block_masks(const char * block, std::string const & bases, uint64_t * masks)
+{
+    size_t count = bases.size();
+    std::fill(masks, masks + count, 0);
+#if defined(__AVX2__)
+    for (size_t i = 0; i < RunSet::block_size; i += 32) {
+        __m256i codes = _mm256_loadu_si256((const __m256i *)(block + i));
+        for (size_t j = 0; j < count; ++j) {
+            __m256i target = _mm256_set1_epi8(bases[j]);
+            masks[j] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(codes, target)) << i;
+        }
+    }
+#elif defined(__SSE2__)
+    for (size_t i = 0; i < RunSet::block_size; i += 16) {
+        __m128i codes = _mm_loadu_si128((const __m128i *)(block + i));
+        for (size_t j = 0; j < count; ++j) {
+            __m128i target = _mm_set1_epi8(bases[j]);
+            masks[j] |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(codes, target)) << i;
+        }
+    }
+#else
+    for (size_t i = 0; i < RunSet::block_size; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            masks[j] |= (uint64_t)(block[i] == bases[j]) << i;
+        }
+    }
+#endif
+}
+
+/*! \brief Find the first position where a run of set bits reaches a length
+ *
+ *  Runs inside the block are found by repeatedly combining the mask with
+ *  itself shifted by doubling distances. A run starting before the block is
+ *  checked using its length carried from the previous block.
+ *
+ *  \param[in]      mask    a mask of block positions holding a base
+ *  \param[in]      size    the number of characters in the block
+ *  \param[in]      length  the minimum length of a run
+ *  \param[in,out]  carry   the length of the run ending at the block start;
+ *                          updated to the length of the run ending at the
+ *                          block end
+ *  \return                 the block position where a run reaches the
+ *                          minimum length or \p size if it is not found
+ */
+static inline size_t find_run(uint64_t mask, size_t size, size_t length, size_t & carry)
+{
+    size_t end = size;
+    if (length <= RunSet::block_size) {
+        uint64_t runs = mask;
+        for (size_t have = 1; have < length && runs; ) {
+            size_t shift = std::min(have, length - have);
+            runs &= runs << shift;
+            have += shift;
+        }
+        if (runs) {
+            end = __builtin_ctzll(runs);
+        }
+    }
+    size_t prefix = ~mask ? __builtin_ctzll(~mask) : RunSet::block_size;
+    if (carry + prefix >= length) {
+        end = std::min(end, length - carry - 1);
+    }
+    uint64_t last = mask << (RunSet::block_size - size);
+    size_t suffix = ~last ? __builtin_clzll(~last) : RunSet::block_size;
+    carry = (suffix == size) ? carry + size : suffix;
+    return end;
+}
+
+/*! \brief Search for the first run in a text prefix
+ *
+ *  Of runs reaching their minimum length at the same position, the longest
+ *  one is reported, and of equal runs the one added last, like in an
+ *  automaton built from the same patterns.
+ *
+ *  \param[in]  text    a text of base codes (see normalize_bases()) to search
+ *                      runs in
+ *  \param[out] pos     the position where the first run reaches its minimum
+ *                      length or \p length if no run was found
+ *  \param[in]  length  the length of the text prefix to search runs in
+ *  \return             the type of the found run
+ */
+Node::Type RunSet::search(const std::string & text, size_t & pos, size_t length) const
+{
+    size_t carries[max_runs] = {0};
+    uint64_t masks[max_runs];
+    char buffer[block_size];
+    for (size_t start = 0; start < length; start += block_size) {
+        size_t size = std::min(block_size, length - start);
+        const char * block = text.data() + start;
+        if (size < block_size) {
+            std::memset(buffer, Automaton::sigma - 1, block_size);
+            std::memcpy(buffer, block, size);
+            block = buffer;
+        }
+        block_masks(block, bases, masks);
+        size_t first = size;
+        size_t longest = 0;
+        Node::Type type = Node::Type::no_match;
+        for (size_t i = 0; i < runs.size(); ++i) {
+            size_t end = find_run(masks[slots[i]], size, runs[i].length, carries[i]);
+            if (end < first || (end == first && end < size && runs[i].length >= longest)) {
+                first = end;
+                longest = runs[i].length;
+                type = runs[i].type;
+            }
+        }
+        if (type) {
+            pos = start + first;
+            return type;
+        }
+    }
+    pos = length;
+    return Node::Type::no_match;
+}
+
+/*! \brief Get the size of memory allocated for the matcher
+ *
+ *  \return     the number of bytes
+ */
+size_t RunSet::memory() const
+{
+    return runs.capacity() * sizeof(Run) + bases.capacity() + slots.capacity() * sizeof(size_t);
+}
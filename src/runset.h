@@ -0,0 +1,55 @@
+#ifndef RUNSET_H
+#define RUNSET_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+#include "search.h"
+
+/*! \brief A matcher of homopolymer runs
+ *
+ *  The class finds runs of a single read base (N runs, poly-G and poly-C
+ *  tracks and so on) without an automaton. Reads are scanned in blocks of
+ *  RunSet::block_size base codes: a bit mask of positions holding each base
+ *  is obtained with vector comparisons and runs are found in the mask with
+ *  shifts, carrying the length of an unfinished run to the next block.
+ */
+class RunSet
+{
+public:
+    /*! \brief A run of a base reported as a match of the specified type */
+    struct Run
+    {
+        char base;          //!< a base in upper case
+        size_t length;      //!< the minimum length of a run
+        Node::Type type;    //!< the match type
+    };
+
+    /*! \brief The maximum number of runs searched together */
+    static const size_t max_runs = 8;
+
+    /*! \brief The number of read characters processed at once */
+    static const size_t block_size = 64;
+
+    bool add(std::string const & pattern, Node::Type type);
+    Node::Type search(const std::string & text, size_t & pos, size_t length) const;
+    size_t memory() const;
+
+    /*! \brief Check if the matcher has no runs
+     *
+     *  \return     whether there are no runs to search
+     */
+    bool empty() const
+    {
+        return runs.empty();
+    }
+
+    void clear();
+
+    std::vector <Run> runs;         //!< runs to search
+    std::string bases;              //!< codes of distinct bases of the runs
+    std::vector <size_t> slots;     //!< indices of bases of the runs in RunSet::bases
+};
+
+#endif // RUNSET_H
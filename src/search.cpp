@@ -1,346 +1,403 @@
 #include "search.h"
 
-#include <list>
-#include <map>
-#include <fstream>
 #include <algorithm>
 
-unsigned int last_id = 1;
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*! \brief Add a node without links to the trie
+ *
+ *  \param[in]  label   a node label
+ *  \return             the index of the new node
+ */
+unsigned int Trie::add_node(char label)
+{
+    Node node = {0, 0, none, Node::Type::no_match, label};
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+/*! \brief Add a child with the specified label to a node
+ *
+ *  \param[in]  node    a node index
+ *  \param[in]  label   a child label
+ *  \return             the index of the new child
+ */
+unsigned int Trie::add_child(unsigned int node, char label)
+{
+    unsigned int child = add_node(label);
+    nodes[child].sibling = nodes[node].child;
+    nodes[node].child = child;
+    return child;
+}
+
+/*! \brief Attach an adapter ID and position to a node
+ *
+ *  The node becomes an adapter node.
+ *
+ *  \param[in]  node    a node index
+ *  \param[in]  id      an adapter ID
+ *  \param[in]  pos     an adapter position
+ */
+void Trie::add_payload(unsigned int node, unsigned int id, unsigned int pos)
+{
+    Payload payload = {id, pos, nodes[node].payload};
+    nodes[node].payload = payloads.size();
+    nodes[node].type = Node::Type::adapter;
+    payloads.push_back(payload);
+}
+
+/*! \brief Get the size of memory allocated for the trie
+ *
+ *  \return     the number of bytes
+ */
+size_t Trie::memory() const
+{
+    return nodes.capacity() * sizeof(Node) + payloads.capacity() * sizeof(Payload);
+}
 
 /*! \brief Build the trie structure
  *
- *  \param[in,out]  root        the structure root
+ *  \param[in,out]  trie        the trie to add patterns to
  *  \param[in]      patterns    the list of patterns for search
- *  \param[in]      errors      the number of resolved mismatches between a read and
- *                              a pattern
  */
-void build_trie(Node & root, std::vector <std::pair <std::string, Node::Type> > const & patterns, int errors)
+void build_trie(Trie & trie, std::vector <std::pair <std::string, Node::Type> > const & patterns)
 {
     for (auto it = patterns.begin(); it != patterns.end(); ++it) {
-        Node * curr_node = &root;
+        unsigned int curr_node = 0;
         const std::string & pattern = it->first;
         size_t pattern_size = pattern.size();
         for (size_t j = 0; j < pattern_size; ++j) {
-            Node * next = curr_node->next(pattern[j]);
-            if (next == NULL) {
-                Node * new_node = new Node(pattern[j]);
-                curr_node->links.push_back(new_node);
-                curr_node = new_node;
-            } else {
-                curr_node = next;
+            unsigned int next = trie.next(curr_node, pattern[j]);
+            if (next == 0) {
+                next = trie.add_child(curr_node, pattern[j]);
             }
+            curr_node = next;
             if (j == pattern_size - 1) {
-                curr_node->type = it->second;
-            }
-            if (it->second == Node::Type::adapter && errors != 0) {
-                if (errors == 1) {
-                    if (j == pattern_size / 2) {
-                        curr_node->update_node_stats(Node::Type::adapter, (size_t)(it - patterns.begin()), pattern_size/2);
-                        curr_node = &root;
-                    } if (j == pattern_size - 1) {
-                        curr_node->update_node_stats(Node::Type::adapter, (size_t)(it - patterns.begin()), pattern_size - 1);
-                    }
-                } if (errors == 2) {
-                    if (j == pattern_size / 3 || j == pattern_size * 2 / 3) {
-                        if (j == pattern_size / 3) {
-                            curr_node->update_node_stats(Node::Type::adapter, (size_t)(it - patterns.begin()), pattern_size / 3);
-                        } else {
-                            curr_node->update_node_stats(Node::Type::adapter, (size_t)(it - patterns.begin()), pattern_size * 2 / 3);
-                        }
-                        curr_node = &root;
-                    } if (j == pattern_size - 1) {
-                        curr_node->update_node_stats(Node::Type::adapter, (size_t)(it - patterns.begin()), pattern_size - 1);
-                    }
-                }
+                trie.nodes[curr_node].type = it->second;
             }
         }
-//		std::cout << patterns[i] << std::endl;
     }
 }
 
-/*! \brief  Add failure nodes to a trie
+/*! \brief The table of base codes used by the flattened automaton */
+struct BaseCodes
+{
+    BaseCodes()
+    {
+        std::fill(codes, codes + 256, 5);
+        const char bases[] = "ACGTN";
+        for (unsigned char i = 0; i < 5; ++i) {
+            codes[(unsigned char)bases[i]] = i;
+            codes[(unsigned char)bases[i] + 32] = i;
+        }
+    }
+
+    unsigned char codes[256];   //!< codes of characters
+};
+
+static const BaseCodes base_codes;
+
+/*! \brief Get a code of a read character
  *
- *  \param[in,out]  root    a root of the trie structure to add failure nodes to
+ *  \param[in]  c   a read character
+ *  \return         0, 1, 2, 3 or 4 for A, C, G, T and N in any case and 5
+ *                  for other characters
  */
-void add_failures(Node & root)
+unsigned char base_code(char c)
 {
-    std::list <Node *> queue;
-    queue.push_back(&root);
-    root.fail = &root;
-    do {
-        Node * curr = queue.front();
-        queue.pop_front();
-        for (std::vector <Node *>::iterator it = curr->links.begin(); it != curr->links.end(); ++it) {
-            if (curr != &root) {
-                Node * parent = curr;
-                do {
-                    parent = parent->fail;
-                    (*it)->fail = parent->next((*it)->label);
-                } while(!(*it)->fail && parent != &root);
-            }
-            if (!(*it)->fail) {
-                (*it)->fail = &root;
-            }
-        }
-        queue.insert(queue.end(), curr->links.begin(), curr->links.end());
-    } while(!queue.empty());
+    return base_codes.codes[(unsigned char)c];
 }
 
-/*! \brief Move to the node with the specified label
+/*! \brief Convert a read to base codes
  *
- *  \param[in,out]  curr    a node to move from
- *  \param[in]      c       a label of a node to move to
+ *  The read is converted in a single pass, 32 or 16 characters at a time
+ *  with AVX2 or SSE2 instructions if the compiler targets them: letters are
+ *  folded to upper case by clearing one bit and compared to the five bases.
+ *  The matchers of a library take the codes instead of read characters, so
+ *  a read is normalized once for all of them.
+ *
+ *  \param[in]  in      a read sequence
+ *  \param[in]  size    the length of the read
+ *  \param[out] codes   the codes of the read characters (see base_code());
+ *                      the string keeps its capacity
  */
-void go(Node * & curr, char c)
+void normalize_bases(const char * in, size_t size, std::string & codes)
 {
-    while (!curr->next(c) && curr != curr->fail) {
-        curr = curr->fail;
+    static const char bases[] = "ACGTN";
+    codes.resize(size);
+    char * out = &codes[0];
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i fold = _mm256_set1_epi8((char)0xDF);
+    for (; i + 32 <= size; i += 32) {
+        __m256i chars = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(in + i)), fold);
+        __m256i result = _mm256_set1_epi8(Automaton::sigma - 1);
+        for (char j = 0; j < 5; ++j) {
+            __m256i found = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(bases[(size_t)j]));
+            result = _mm256_blendv_epi8(result, _mm256_set1_epi8(j), found);
+        }
+        _mm256_storeu_si256((__m256i *)(out + i), result);
     }
-    Node * next = curr->next(c);
-    if (next) {
-        curr = next;
+#elif defined(__SSE2__)
+    const __m128i fold = _mm_set1_epi8((char)0xDF);
+    for (; i + 16 <= size; i += 16) {
+        __m128i chars = _mm_and_si128(_mm_loadu_si128((const __m128i *)(in + i)), fold);
+        __m128i result = _mm_set1_epi8(Automaton::sigma - 1);
+        for (char j = 0; j < 5; ++j) {
+            __m128i found = _mm_cmpeq_epi8(chars, _mm_set1_epi8(bases[(size_t)j]));
+            result = _mm_or_si128(_mm_andnot_si128(found, result),
+                                  _mm_and_si128(found, _mm_set1_epi8(j)));
+        }
+        _mm_storeu_si128((__m128i *)(out + i), result);
+    }
+#endif
+    for (; i < size; ++i) {
+        out[i] = base_code(in[i]);
     }
 }
 
-/*! \brief Find all matches for the specified patterns
+/*! \brief Convert a read to base codes
  *
- *  \todo Describe function arguments and the value it returns.
+ *  \param[in]  text    a read sequence
+ *  \param[out] codes   the codes of the read characters (see base_code())
  */
-Node::Type find_all_matches(Node * node, size_t pos,
-                      std::map <size_t, std::vector <std::pair<size_t, size_t> > > & matches,
-                      size_t errors) {
-    Node * curr = node;
-    while (curr->fail != curr) {
-        if (curr->type) {
-            if (curr->type != Node::Type::adapter) {
-                return curr->type;
-            }
-            for (auto it = curr->adapter_id_pos.begin(); it != curr->adapter_id_pos.end(); ++it) {
-                std::vector <std::pair<size_t, size_t> > & curr_matches = matches[it->first];
-                curr_matches.push_back(std::make_pair(pos, it->second));
-                if (curr_matches.size() >= errors + 1){
-                    size_t begin_pos = pos - it->second;
-                    size_t pattern_size = it->second + 1;
-                    if (errors == 1 &&
-                        std::binary_search(curr_matches.begin(), curr_matches.end(), std::pair <size_t, size_t> (begin_pos + pattern_size / 2, pattern_size / 2))) {
-                        return curr->type;
-                    }
-                    if (errors == 2 &&
-                        std::binary_search(curr_matches.begin(), curr_matches.end(),
-                                           std::pair <size_t, size_t> (begin_pos + pattern_size / 3, pattern_size / 3)) &&
-                        std::binary_search(curr_matches.begin(), curr_matches.end(),
-                                           std::pair <size_t, size_t> (begin_pos + pattern_size * 2 / 3, pattern_size * 2 / 3))) {
-                        return curr->type;
-                    }
-                }
-            }
+void normalize_bases(const std::string & text, std::string & codes)
+{
+    normalize_bases(text.data(), text.size(), codes);
+}
+
+/*! \brief Get the reverse complement of a pattern
+ *
+ *  IUPAC codes of degenerate bases are complemented as well, other
+ *  characters are kept as is.
+ *
+ *  \param[in]  pattern     a pattern in upper case
+ *  \return                 the reverse complement of the pattern
+ */
+std::string reverse_complement(std::string const & pattern)
+{
+    static const std::string bases = "ACGTRYKMBVDHSWN";
+    static const std::string complements = "TGCAYRMKVBHDSWN";
+    std::string res(pattern.rbegin(), pattern.rend());
+    for (auto it = res.begin(); it != res.end(); ++it) {
+        size_t i = bases.find(*it);
+        if (i != std::string::npos) {
+            *it = complements[i];
         }
-        curr = curr->fail;
     }
-    return Node::Type::no_match;
+    return res;
 }
 
-/*! \brief Fidn a single match for the specified pattern
+const unsigned int Trie::none;
+const unsigned int Automaton::none;
+const size_t Automaton::lanes;
+
+/*! \brief Add payloads of a trie node to automaton output lists
  *
- *  \todo Describe function arguments and the value it returns.
+ *  \param[in]      trie    a trie
+ *  \param[in]      node    a node index
+ *  \param[in]      next    the index of the output following the node outputs
+ *  \param[in,out]  outputs output lists of automaton states
+ *  \return                 the index of the first output of the node
  */
-Node::Type find_match(Node * node) {
-    Node * curr = node;
-    while (curr->fail != curr) {
-        if (curr->type) {
-            return curr->type;
-        }
-        curr = curr->fail;
+static unsigned int add_outputs(Trie const & trie, unsigned int node, unsigned int next,
+                                std::vector <Automaton::Output> & outputs)
+{
+    for (unsigned int i = trie.nodes[node].payload; i != Trie::none; i = trie.payloads[i].next) {
+        Automaton::Output output = {trie.payloads[i].id, trie.payloads[i].pos, next};
+        next = outputs.size();
+        outputs.push_back(output);
     }
-    return Node::Type::no_match;
+    return next;
 }
 
-/*! \brief Compare upper cases of the specified characeters
+/*! \brief Get the size of memory allocated for the automaton
  *
- *  \param[in]  i   the first character to be compared
- *  \param[in]  j   the second character to be compared
- *  \return         whether upper cases of the specified charaters are equal or not
+ *  \return     the number of bytes
  */
-bool cmp_upper(char i, char j)
+size_t Automaton::memory() const
 {
-    return std::toupper(i) == std::toupper(j);
+    return transitions.memory() + types.memory() + first_outputs.memory() + outputs.memory();
 }
 
-/*! \brief Count errors between a text and a pattern
+/*! \brief Check if tables of an automaton loaded from an index file are consistent
  *
- *  \param[in]  text        a text string
- *  \param[in]  text_pos    a position to compare \p text from
- *  \param[in]  pattern     a pattern string
- *  \param[in]  pattern_pos a position to compare \p pattern from
- *  \param[in]  length      the length of the \p text fragment to compare
- *  \param[in]  err_max     the maxumum number of errors
+ *  Transitions must lead to existing states, match types must be known and
+ *  output lists must stay within the output table. As build_automaton()
+ *  adds them, each output links to an earlier one, so the lists end.
  *
- *  \return     the number of mismatches (errors) between the specified text and
- *              pattern
+ *  \return     whether the automaton may be searched
  */
-int count_errors(std::string const & text, size_t text_pos,
-                 std::string const & pattern, size_t pattern_pos,
-                 size_t length, int err_max)
+bool Automaton::valid() const
 {
-    auto text_it = text.begin() + text_pos;
-    auto text_last = text_it + length;
-    auto pattern_it = pattern.begin() + pattern_pos;
-    int errors = 0;
-    while (errors <= err_max) {
-        auto mismatch = std::mismatch(text_it, text_last, pattern_it, cmp_upper);
-        if (mismatch.first == text_last) {
-            return errors;
+    size_t states = types.size();
+    if (transitions.size() != states * sigma || first_outputs.size() != states) {
+        return false;
+    }
+    for (size_t i = 0; i < transitions.size(); ++i) {
+        if (transitions[i] >= states) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < states; ++i) {
+        if ((unsigned int)types[i] > Node::Type::polyT ||
+                (first_outputs[i] != none && first_outputs[i] >= outputs.size())) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (outputs[i].next != none && outputs[i].next >= i) {
+            return false;
         }
-        ++errors;
-        text_it = ++mismatch.first;
-        pattern_it = ++mismatch.second;
     }
-    return errors;
+    return true;
 }
 
-/*! \brief Check for partial matches between a text and patterns
+/*! \brief Compile a trie into a flattened automaton
  *
- *  \param[in]  text        a text to be compared to patterns
- *  \param[in]  patterns    a list of patterns to compare the specified text to
- *  \param[out] matches     matches between the specified text and patterns
- *  \param[in]  errors      the number of mismatches between a text and patterns
+ *  Goto and failure transitions are resolved in advance for every state and
+ *  every column of the transition table, so the trie keeps no failure
+ *  links. Characters other than A, C, G, T and N always lead to the root,
+ *  so trie branches labeled by other characters are not reachable in the
+ *  automaton.
  *
- *  \return     whether any partial matches were found or not
+ *  Adapter IDs and positions kept in trie nodes become output lists of
+ *  the corresponding states.
+ *
+ *  \param[in]  trie        a trie built by build_trie()
+ *  \param[out] automaton   the automaton to build
  */
-bool check_partial_matches(std::string const & text,
-                           std::vector <std::pair<std::string, Node::Type> > const & patterns,
-                           std::map <size_t, std::vector <std::pair <size_t, size_t> > > & matches, int errors)
+void build_automaton(Trie const & trie, Automaton & automaton)
 {
-    for (auto it = matches.begin(); it != matches.end(); ++it) {
-        size_t pattern_size = patterns[it->first].first.size();
-        while (!it->second.empty()) {
-            auto start_match = it->second.begin();
-            int res_errors = 0;
-            size_t begin_pos = start_match->first;
-            if (errors == 1) {
-                if (start_match->second == pattern_size - 1) {
-                    begin_pos -= pattern_size - 1;
-                    res_errors = count_errors(text, begin_pos,
-                                              patterns[it->first].first, 0, pattern_size/2, 1);
-                } else {
-                    begin_pos -= pattern_size/2;
-                    res_errors = count_errors(text, start_match->first,
-                                              patterns[it->first].first, start_match->second, pattern_size - start_match->second, 1);
-                }
-            } else {
-                if (start_match->second == pattern_size - 1) {
-                    begin_pos -= pattern_size - 1;
-                    res_errors = count_errors(text, begin_pos,
-                                              patterns[it->first].first, 0, pattern_size / 3, 1);
-                    if (res_errors < 2) {
-                        res_errors += count_errors(text, begin_pos + pattern_size / 3,
-                                                  patterns[it->first].first, pattern_size / 3, pattern_size * 2/3 - pattern_size / 3, 1);
-                    } else {
-                        ++res_errors;
-                    }
-                } else if (start_match->second == pattern_size * 2/3) {
-                    begin_pos -= pattern_size * 2/3;
-                    auto found = std::lower_bound(it->second.begin(), it->second.end(),
-                                                  std::pair <size_t, size_t> (begin_pos + pattern_size - 1, pattern_size - 1));
-                    if (*found == std::pair <size_t, size_t> (begin_pos + pattern_size - 1, pattern_size - 1)){
-                        res_errors = count_errors(text, begin_pos,
-                                                  patterns[it->first].first, 0, pattern_size / 3, 2);
-                        it->second.erase(found);
-                    } else {
-                        res_errors = count_errors(text, begin_pos,
-                                                  patterns[it->first].first, 0, pattern_size / 3, 1);
-                        if (res_errors < 2) {
-                            res_errors += count_errors(text, begin_pos + pattern_size * 2/3,
-                                                      patterns[it->first].first, pattern_size * 2/3, pattern_size - pattern_size * 2/3, 1);
-                        } else {
-                            ++res_errors;
-                        }
-                    }
-                } else {
-                    begin_pos -= pattern_size/3;
-                    auto found = std::lower_bound(it->second.begin(), it->second.end(),
-                                                  std::pair <size_t, size_t> (begin_pos + pattern_size * 2/3, pattern_size * 2/3));
-                    if (*found == std::pair <size_t, size_t> (begin_pos + pattern_size * 2/3, pattern_size * 2/3)) {
-                        res_errors = count_errors(text, begin_pos + pattern_size / 3,
-                                                  patterns[it->first].first, pattern_size * 2/3, pattern_size - pattern_size * 2/3, 2);
-                        it->second.erase(found);
-                    } else {
-                        found = std::lower_bound(it->second.begin(), it->second.end(),
-                                                 std::pair <size_t, size_t> (begin_pos + pattern_size - 1, pattern_size - 1));
-                        if (*found == std::pair <size_t, size_t> (begin_pos + pattern_size - 1, pattern_size - 1)) {
-                            res_errors = count_errors(text, begin_pos + pattern_size / 3,
-                                                      patterns[it->first].first, pattern_size / 3, pattern_size * 2/3 - pattern_size * 1/3, 2);
-                            it->second.erase(found);
-                        } else {
-                            res_errors = count_errors(text, begin_pos + pattern_size / 3,
-                                                      patterns[it->first].first, pattern_size / 3, pattern_size * 2/3 - pattern_size * 1/3, 1);
-                            if (res_errors < 2) {
-                                res_errors += count_errors(text, begin_pos + pattern_size * 2/3,
-                                                          patterns[it->first].first, pattern_size * 2/3, pattern_size - pattern_size * 2/3, 1);
-                            } else {
-                                ++res_errors;
-                            }
-                        }
-                    }
-                }
+    std::vector <unsigned int> states;
+    std::vector <unsigned int> fails;
+    std::vector <unsigned int> transitions;
+    std::vector <Node::Type> types;
+    std::vector <unsigned int> first_outputs;
+    std::vector <Automaton::Output> outputs;
+    transitions.reserve(trie.nodes.size() * Automaton::sigma);
+    types.reserve(trie.nodes.size());
+    first_outputs.reserve(trie.nodes.size());
+    outputs.reserve(trie.payloads.size());
+    states.reserve(trie.nodes.size());
+    fails.reserve(trie.nodes.size());
+    states.push_back(0);
+    fails.push_back(0);
+    types.push_back(Node::Type::no_match);
+    first_outputs.push_back(add_outputs(trie, 0, Automaton::none, outputs));
+    for (size_t i = 0; i < states.size(); ++i) {
+        transitions.resize((i + 1) * Automaton::sigma, 0);
+        if (i != 0) {
+            for (size_t c = 0; c < Automaton::sigma - 1; ++c) {
+                transitions[i * Automaton::sigma + c] = transitions[fails[i] * Automaton::sigma + c];
             }
-            it->second.erase(start_match);
-            if (res_errors <= errors) {
-                return true;
+        }
+        for (unsigned int child = trie.nodes[states[i]].child; child != 0; child = trie.nodes[child].sibling) {
+            Node const & node = trie.nodes[child];
+            unsigned char code = base_code(node.label);
+            if (code == Automaton::sigma - 1) {
+                continue;
             }
+            unsigned int fail = (i == 0) ? 0 : transitions[fails[i] * Automaton::sigma + code];
+            transitions[i * Automaton::sigma + code] = states.size();
+            states.push_back(child);
+            fails.push_back(fail);
+            types.push_back(node.type ? node.type : types[fail]);
+            first_outputs.push_back(add_outputs(trie, child, first_outputs[fail], outputs));
         }
     }
-    return false;
+    automaton.transitions.assign(transitions);
+    automaton.types.assign(types);
+    automaton.first_outputs.assign(first_outputs);
+    automaton.outputs.assign(outputs);
 }
 
-/*! \brief Search for inexact pattern matches in a text
+/*! \brief Search for the first match between a text prefix and a flattened automaton
  *
- *  \param[in]  text        a text to search pattern matches in
- *  \param[in]  root        a root of the trie structure for search
- *  \param[in]  patterns    a vector of patterns to search for in a text
- *  \param[in]  errors      the number of mismatches between a text and patterns
+ *  \param[in]  text        a text of base codes (see normalize_bases()) to
+ *                          search matches in
+ *  \param[in]  automaton   an automaton compiled by build_automaton()
+ *  \param[out] pos         the end position of the match in the text or
+ *                          \p length if no match was found
+ *  \param[in]  length      the length of the text prefix to search matches in
  *
  *  \return     an identified match type
  */
-Node::Type search_inexact(const std::string & text, Node * root,
-                          std::vector <std::pair<std::string, Node::Type> > const & patterns,
-                          int errors)
+Node::Type search_any(const std::string & text, Automaton const & automaton, size_t & pos, size_t length)
 {
-    size_t text_len = text.size();
-    std::map <size_t, std::vector <std::pair <size_t, size_t> > > matches; // value - <text_pos, adapter_pos>
-    Node * curr = root;
-    for (size_t i = 0; i < text_len; ++i) {
-        char c = (text[i] > 96) ? text[i] - 32 : text[i];
-        go(curr, c);
-        Node::Type match_type = find_all_matches(curr, i, matches, errors);
-        if(match_type) {
-            return match_type;
+    unsigned int state = 0;
+    for (pos = 0; pos < length; ++pos) {
+        state = automaton.next(state, text[pos]);
+        if (automaton.types[state]) {
+            return automaton.types[state];
         }
     }
-    if (check_partial_matches(text, patterns, matches, errors)) {
-        return Node::Type::adapter;
-    }
     return Node::Type::no_match;
 }
 
-/*! \brief Seach for any matches between a text and a trie
+/*! \brief Search for the first matches between text prefixes and a flattened automaton
  *
- *  \param[in]  text    a text to search matches in
- *  \param[in]  root    a root of the trie structure for match search
+ *  Up to Automaton::lanes texts are advanced through the automaton in
+ *  lockstep, one character of each text per round. The next transition and
+ *  the type of the next state of every text are prefetched while the other
+ *  texts are processed, so cache misses of different texts overlap instead
+ *  of stalling each step. A text which is matched or ends leaves the batch
+ *  and the next text takes its place. The results are the same as those of
+ *  search_any() for each text.
  *
- *  \return     an idenfitied match type
+ *  \param[in]      texts       texts of base codes (see normalize_bases()) to
+ *                              search matches in
+ *  \param[in]      count       the number of texts
+ *  \param[in]      automaton   an automaton compiled by build_automaton()
+ *  \param[in,out]  ends        the lengths of the text prefixes to search
+ *                              matches in, replaced with the end positions of
+ *                              the matches or kept if no match was found
+ *  \param[out]     types       identified match types
  */
-Node::Type search_any(const std::string & text, Node * root)
+void search_batch(const std::string * const texts[], size_t count, Automaton const & automaton,
+                  size_t ends[], Node::Type types[])
 {
-    size_t text_len = text.size();
-    Node * curr = root;
-    for (size_t i = 0; i < text_len; ++i) {
-        char c = (text[i] > 96) ? text[i] - 32 : text[i];
-        go(curr, c);
-        Node::Type match_type = find_match(curr);
-        if(match_type) {
-            return match_type;
+    struct Lane
+    {
+        const char * text;
+        size_t index;
+        size_t pos;
+        unsigned int state;
+    };
+
+    Lane lanes[Automaton::lanes];
+    size_t active = 0;
+    size_t next = 0;
+    while (active || next < count) {
+        while (active < Automaton::lanes && next < count) {
+            types[next] = Node::Type::no_match;
+            if (ends[next]) {
+                Lane lane = {texts[next]->data(), next, 0, 0};
+                lanes[active++] = lane;
+            }
+            ++next;
+        }
+        for (size_t i = 0; i < active; ) {
+            Lane & lane = lanes[i];
+            Node::Type type = lane.pos ? automaton.types[lane.state] : Node::Type::no_match;
+            if (type || lane.pos == ends[lane.index]) {
+                if (type) {
+                    ends[lane.index] = lane.pos - 1;
+                    types[lane.index] = type;
+                }
+                lane = lanes[--active];
+                continue;
+            }
+            lane.state = automaton.next(lane.state, lane.text[lane.pos]);
+            ++lane.pos;
+            __builtin_prefetch(&automaton.types[lane.state]);
+            if (lane.pos < ends[lane.index]) {
+                __builtin_prefetch(&automaton.transitions[lane.state * Automaton::sigma +
+                                                          lane.text[lane.pos]]);
+            }
+            ++i;
         }
     }
-    return Node::Type::no_match;
 }
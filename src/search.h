@@ -2,94 +2,168 @@
 #define SEARCH_H
 
 #include <vector>
-#include <list>
-#include <map>
 #include <string>
 #include <cstddef>
 
+#include "array.h"
+
 /*! \brief A trie node
  *
- *  The class implements a node of the trie structure for string matching.
+ *  The structure implements a node of the trie structure for string
+ *  matching. Nodes are kept in the Trie::nodes array and refer to each other
+ *  by 32-bit indices; children of a node form a list linked by the
+ *  Node::sibling indices.
  */
-class Node
+struct Node
 {
-public:
-
     /*! \brief Node type
      *
-     *  The enumeration values correspond to various pattern types.
+     *  The enumeration values correspond to various pattern types and are
+     *  equal to the ReadType values of reads containing the patterns.
      */
     enum Type {
         no_match = 0,   //!< a pattern corresponding to no match
         adapter = 1,    //!< an adapter fragment
         n,              //!< a gap
         polyG,          //!< a poly-G sequence
-        polyC           //!< a poly-C sequence
+        polyC,          //!< a poly-C sequence
+        polyA = 7,      //!< a poly-A sequence
+        polyT           //!< a poly-T sequence
     };
 
-    /*! \brief Initialize a node with a label
-     *
-     *  \param[in]  label   a node label
-     */
-    Node(char label) :
-        label(label), fail(NULL), type(Type::no_match)
-    {}
+    unsigned int child;     //!< the index of the first child or 0 if there are no children
+    unsigned int sibling;   //!< the index of the next sibling or 0 if it is the last child
+    unsigned int payload;   //!< the index of the first payload or Trie::none
+    Type type;              //!< a node type
+    char label;             //!< a node label
+};
 
-    /*! \brief The node destructor
+/*! \brief A trie of patterns
+ *
+ *  The class keeps all trie nodes in a single array, the root is node 0.
+ *  Adapter IDs and positions attached to nodes are kept in a side table of
+ *  payloads, which are linked into a list per node.
+ */
+class Trie
+{
+public:
+    /*! \brief An adapter ID and position attached to a node */
+    struct Payload
+    {
+        unsigned int id;    //!< an adapter ID
+        unsigned int pos;   //!< an adapter position
+        unsigned int next;  //!< the index of the next payload of the node or Trie::none
+    };
+
+    /*! \brief The index marking the end of a payload list */
+    static const unsigned int none = ~0u;
+
+    /*! \brief Initialize a trie consisting of the root */
+    Trie()
+    {
+        add_node('0');
+    }
+
+    /*! \brief Get the child of a node with the specified label
      *
-     *  Deletes nodes the current node has links to.
+     *  \param[in]  node    a node index
+     *  \param[in]  c       a node label
+     *  \return             the index of the child with the specified label or
+     *                      0 if there is no such child
      */
-    ~Node()
+    unsigned int next(unsigned int node, char c) const
     {
-        for (auto it = links.begin(); it != links.end(); ++it) {
-            delete *it;
+        for (unsigned int i = nodes[node].child; i != 0; i = nodes[i].sibling) {
+            if (nodes[i].label == c) {
+                return i;
+            }
         }
+        return 0;
     }
 
-    /*! \brief Get the next node with the specified label
+    unsigned int add_node(char label);
+    unsigned int add_child(unsigned int node, char label);
+    void add_payload(unsigned int node, unsigned int id, unsigned int pos);
+    size_t memory() const;
+
+    std::vector <Node> nodes;       //!< trie nodes
+    std::vector <Payload> payloads; //!< adapter IDs and positions attached to nodes
+};
+
+/*! \brief A flattened Aho-Corasick automaton
+ *
+ *  The class keeps a deterministic automaton compiled from a trie of
+ *  patterns. Transitions are stored in a contiguous table of
+ *  Automaton::sigma columns per state, so the automaton makes exactly one
+ *  table lookup per text character. State 0 is the trie root.
+ */
+class Automaton
+{
+public:
+    /*! \brief The number of transitions per state
+     *
+     *  Columns correspond to codes of A, C, G, T, N and any other character.
+     */
+    static const size_t sigma = 6;
+
+    /*! \brief The number of texts advanced in lockstep by search_batch() */
+    static const size_t lanes = 16;
+
+    /*! \brief Get the state to move to from the specified state
      *
-     *  \param[in]  c   a node label
-     *  \return         the pointer to the next node with specified label
+     *  \param[in]  state   a current state
+     *  \param[in]  code    a code of a text character (see base_code())
+     *  \return             the next state
      */
-    Node * next(char c)
+    unsigned int next(unsigned int state, unsigned char code) const
     {
-        for (size_t i = 0; i < links.size(); ++i) {
-            if (links[i]->label == c)
-                return links[i];
-        }
-        return NULL;
+        return transitions[state * sigma + code];
     }
 
-    /*! \brief Update node statistics
+    size_t memory() const;
+    bool valid() const;
+
+    /*! \brief Check if the automaton has no patterns
      *
-     *  \param[in]  t           a node type
-     *  \param[in]  adapt_id    an adapter ID
-     *  \param[in]  adapt_pos   an adapter position
+     *  \return     whether the automaton consists of the root state only
      */
-    void update_node_stats(Type t, size_t adapt_id, size_t adapt_pos)
+    bool empty() const
     {
-        type = t;
-        adapter_id_pos.push_back(std::make_pair(adapt_id, adapt_pos));
+        return types.size() <= 1;
     }
 
-    char label;     //!< a node label
-    Node * fail;    //!< a pointer to the node corresponding to matching failure
-    Type type;      //!< a node type
-    std::list <std::pair <size_t, size_t> > adapter_id_pos; //!< an adapter ID and position
-    std::vector <Node *> links; //!< the list of links to other nodes
+    /*! \brief A pattern position reported in a state
+     *
+     *  Outputs are taken from payloads of trie nodes.
+     *  Outputs of a state are followed by outputs of its nearest suffix
+     *  state having any, so the list of a state enumerates all of them.
+     */
+    struct Output
+    {
+        unsigned int id;    //!< a pattern ID
+        unsigned int pos;   //!< a pattern position
+        unsigned int next;  //!< the index of the next output or Automaton::none
+    };
+
+    /*! \brief The index marking the end of an output list */
+    static const unsigned int none = ~0u;
+
+    Array <unsigned int> transitions;   //!< the transition table
+    Array <Node::Type> types;           //!< match types reported in each state
+    Array <unsigned int> first_outputs; //!< indices of the first outputs of each state
+    Array <Output> outputs;             //!< output lists of all states
 };
 
-void build_trie(Node & root,
-                std::vector <std::pair <std::string, Node::Type> > const & patterns,
-                int errors = 0);
-void add_failures(Node & root);
-void go(Node * & curr, char c);
-Node::Type find_match(Node * node);
-Node::Type find_all_matches(Node * node, size_t pos,
-                      std::map <size_t, std::vector <std::pair<size_t, size_t> > > & matches,
-                      size_t errors);
-Node::Type search_inexact(const std::string & text, Node * root,
-                          std::vector <std::pair<std::string, Node::Type> > const & patterns, int errors);
-Node::Type search_any(const std::string & text, Node * root);
+unsigned char base_code(char c);
+void normalize_bases(const char * in, size_t size, std::string & codes);
+void normalize_bases(const std::string & text, std::string & codes);
+std::string reverse_complement(std::string const & pattern);
+
+void build_trie(Trie & trie,
+                std::vector <std::pair <std::string, Node::Type> > const & patterns);
+void build_automaton(Trie const & trie, Automaton & automaton);
+Node::Type search_any(const std::string & text, Automaton const & automaton, size_t & pos, size_t length);
+void search_batch(const std::string * const texts[], size_t count, Automaton const & automaton,
+                  size_t ends[], Node::Type types[]);
 
 #endif // SEARCH_H
@@ -0,0 +1,315 @@
+#include "seedset.h"
+#include "shiftand.h"
+
+#include <algorithm>
+
+/*! \brief Split a pattern into seeds
+ *
+ *  Seeds are disjoint stretches of A, C, G and T bases. The stretches of
+ *  the pattern are cut into pieces of the largest length that still gives
+ *  the requested number of pieces, and the longest pieces are taken.
+ *
+ *  \param[in]  pattern     a pattern in upper case
+ *  \param[in]  count       the number of seeds
+ *  \param[out] seeds       start positions and lengths of the seeds, empty if
+ *                          the pattern can not be split
+ *  \return                 the length of the shortest seed or 0 if the
+ *                          pattern can not be split
+ */
+size_t find_seeds(std::string const & pattern, size_t count,
+                  std::vector <std::pair <size_t, size_t> > & seeds)
+{
+    std::vector <std::pair <size_t, size_t> > runs;
+    size_t longest = 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (base_code(pattern[i]) >= 4) {
+            continue;
+        }
+        if (runs.empty() || runs.back().first + runs.back().second != i) {
+            runs.push_back(std::make_pair(i, 0));
+        }
+        longest = std::max(longest, ++runs.back().second);
+    }
+    seeds.clear();
+    for (size_t length = longest; length > 0; --length) {
+        size_t total = 0;
+        for (auto it = runs.begin(); it != runs.end(); ++it) {
+            total += it->second / length;
+        }
+        if (total < count) {
+            continue;
+        }
+        std::vector <std::pair <size_t, size_t> > pieces;
+        for (auto it = runs.begin(); it != runs.end(); ++it) {
+            size_t parts = it->second / length;
+            size_t start = it->first;
+            for (size_t j = 0; j < parts; ++j) {
+                size_t size = it->second / parts + (j < it->second % parts ? 1 : 0);
+                pieces.push_back(std::make_pair(size, start));
+                start += size;
+            }
+        }
+        std::stable_sort(pieces.begin(), pieces.end(),
+                         [](std::pair <size_t, size_t> const & a, std::pair <size_t, size_t> const & b) {
+                             return a.first > b.first;
+                         });
+        for (size_t j = 0; j < count; ++j) {
+            seeds.push_back(std::make_pair(pieces[j].second, pieces[j].first));
+        }
+        return pieces[count - 1].first;
+    }
+    return 0;
+}
+
+/*! \brief Build the matcher from a list of patterns
+ *
+ *  Patterns which can not be split into enough seeds are verified at every
+ *  text position.
+ *
+ *  \param[in]  patterns    a list of patterns in upper case
+ *  \param[in]  errors      the number of allowed errors
+ *  \param[in]  edit        whether insertions and deletions are allowed
+ */
+void SeedSet::build(std::vector <std::string> const & patterns, int errors, bool edit)
+{
+    this->errors = errors;
+    this->edit = edit;
+    Trie trie;
+    std::vector <char> masks;
+    std::vector <unsigned int> offsets(1, 0);
+    std::vector <std::pair <size_t, size_t> > seeds;
+    for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+        if (it->empty()) {
+            continue;
+        }
+        if (!find_seeds(*it, errors + 1, seeds)) {
+            trie.add_payload(0, offsets.size() - 1, it->size());
+        }
+        for (auto seed = seeds.begin(); seed != seeds.end(); ++seed) {
+            unsigned int curr_node = 0;
+            for (size_t j = seed->first; j < seed->first + seed->second; ++j) {
+                unsigned int next = trie.next(curr_node, (*it)[j]);
+                if (next == 0) {
+                    next = trie.add_child(curr_node, (*it)[j]);
+                }
+                curr_node = next;
+            }
+            trie.add_payload(curr_node, offsets.size() - 1, seed->first + seed->second);
+        }
+        for (size_t j = 0; j < it->size(); ++j) {
+            masks.push_back(iupac_mask((*it)[j]));
+        }
+        offsets.push_back(masks.size());
+    }
+    build_automaton(trie, automaton);
+    this->masks.assign(masks);
+    this->offsets.assign(offsets);
+    select_kernel();
+}
+
+/*! \brief Select the search function for the error mode of the matcher
+ *
+ *  Search functions are instantiated for mismatches only and for edit
+ *  distance, and mismatch search also for the common numbers of errors, so
+ *  their inner loops do not test the mode. The function should be called
+ *  whenever SeedSet::errors or SeedSet::edit change.
+ */
+void SeedSet::select_kernel()
+{
+    if (edit) {
+        kernel = &SeedSet::search_kernel <true, 0>;
+    } else if (errors == 1) {
+        kernel = &SeedSet::search_kernel <false, 1>;
+    } else if (errors == 2) {
+        kernel = &SeedSet::search_kernel <false, 2>;
+    } else {
+        kernel = &SeedSet::search_kernel <false, 0>;
+    }
+}
+
+/*! \brief The cost exceeding any number of errors */
+static const int infinite_cost = 1 << 20;
+
+/*! \brief Align a pattern fragment with text fragments
+ *
+ *  Both fragments start at the specified positions and go in the same
+ *  direction. The pattern fragment is aligned as a whole, while the text
+ *  fragment may have any length. Only the band of \p errors diagonals
+ *  around the main one is computed.
+ *
+ *  \param[in]  text    the first base code of the text fragment
+ *  \param[in]  avail   the number of text characters available
+ *  \param[in]  mask    the first position mask of the pattern fragment
+ *  \param[in]  size    the length of the pattern fragment
+ *  \param[in]  step    1 to go forward and -1 to go backward
+ *  \param[in]  errors  the number of allowed errors
+ *  \param[out] costs   edit distances between the pattern fragment and text
+ *                      fragments of each length, infinite_cost for lengths
+ *                      out of the band
+ *  \return             whether any distance does not exceed \p errors
+ */
+static bool align(const char * text, size_t avail, const char * mask, size_t size,
+                  ptrdiff_t step, int errors, std::vector <int> & costs)
+{
+    size_t band = errors;
+    size_t width = std::min(avail, size + band);
+    costs.assign(width + 1, infinite_cost);
+    for (size_t j = 0; j <= std::min(width, band); ++j) {
+        costs[j] = j;
+    }
+    for (size_t i = 1; i <= size; ++i) {
+        unsigned char bases = mask[step * (ptrdiff_t)(i - 1)];
+        size_t first = (i > band) ? i - band : 0;
+        size_t last = std::min(width, i + band);
+        if (first > last) {
+            return false;
+        }
+        int diagonal = infinite_cost;
+        int left = infinite_cost;
+        if (first == 0) {
+            diagonal = costs[0];
+            left = costs[0] = i;
+            first = 1;
+        } else {
+            diagonal = costs[first - 1];
+            costs[first - 1] = infinite_cost;
+        }
+        int best = left;
+        for (size_t j = first; j <= last; ++j) {
+            int up = costs[j];
+            int match = (bases & (1 << text[step * (ptrdiff_t)(j - 1)])) ? 0 : 1;
+            left = std::min(std::min(up, left) + 1, diagonal + match);
+            costs[j] = left;
+            diagonal = up;
+            best = std::min(best, left);
+        }
+        if (best > errors) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*! \brief Verify a seed match
+ *
+ *  \tparam     with_indels     whether insertions and deletions are allowed
+ *  \tparam     fixed_errors    the number of allowed errors or 0 if it is
+ *                              taken from SeedSet::errors
+ *  \param[in]  text    a text of base codes
+ *  \param[in]  end     the text position following the seed match
+ *  \param[in]  length  the length of the text prefix to search patterns in
+ *  \param[in]  id      a pattern ID
+ *  \param[in]  pos     the pattern position following the seed
+ *  \param[out] costs   a buffer for edit distances
+ *  \return             the end position of the pattern match or \p length if
+ *                      the pattern does not match
+ */
+template <bool with_indels, int fixed_errors>
+size_t SeedSet::verify(const std::string & text, size_t end, size_t length,
+                       unsigned int id, size_t pos, std::vector <int> & costs) const
+{
+    const int errors = fixed_errors ? fixed_errors : this->errors;
+    const char * mask = masks.data() + offsets[id];
+    size_t size = offsets[id + 1] - offsets[id];
+    if (!with_indels) {
+        if (end < pos || end - pos + size > length) {
+            return length;
+        }
+        const char * start = text.data() + end - pos;
+        int mismatches = 0;
+        for (size_t j = 0; j < size; ++j) {
+            if (!(mask[j] & (1 << start[j])) && ++mismatches > errors) {
+                return length;
+            }
+        }
+        return end - pos + size - 1;
+    }
+
+    int prefix = 0;
+    if (pos > 0) {
+        if (!align(text.data() + end - 1, end, mask + pos - 1, pos, -1, errors, costs)) {
+            return length;
+        }
+        prefix = *std::min_element(costs.begin(), costs.end());
+    }
+    if (!align(text.data() + end, length - end, mask + pos, size - pos, 1, errors - prefix, costs)) {
+        return length;
+    }
+    for (size_t j = 0; j < costs.size(); ++j) {
+        if (costs[j] <= errors - prefix) {
+            return end + j - 1;
+        }
+    }
+    return length;
+}
+
+/*! \brief Search for the first pattern match in a text prefix
+ *
+ *  Since a seed match ends not later than the pattern match containing it,
+ *  the scan stops at the end of the first verified match.
+ *
+ *  \tparam     with_indels     whether insertions and deletions are allowed
+ *  \tparam     fixed_errors    the number of allowed errors or 0 if it is
+ *                              taken from SeedSet::errors
+ *  \param[in]  text    a text of base codes (see normalize_bases()) to search
+ *                      patterns in
+ *  \param[in]  length  the length of the text prefix to search patterns in
+ *  \param[out] costs   a buffer for edit distances
+ *  \return             the end position of the first match or \p length if
+ *                      no match was found
+ */
+template <bool with_indels, int fixed_errors>
+size_t SeedSet::search_kernel(const std::string & text, size_t length, std::vector <int> & costs) const
+{
+    unsigned int state = 0;
+    for (size_t i = 0; i < length; ++i) {
+        state = automaton.next(state, text[i]);
+        for (unsigned int o = automaton.first_outputs[state]; o != Automaton::none; ) {
+            Automaton::Output const & output = automaton.outputs[o];
+            length = verify <with_indels, fixed_errors> (text, i + 1, length, output.id, output.pos, costs);
+            o = output.next;
+        }
+    }
+    return length;
+}
+
+/*! \brief Get the size of memory allocated for the matcher
+ *
+ *  \return     the number of bytes
+ */
+size_t SeedSet::memory() const
+{
+    return automaton.memory() + masks.memory() + offsets.memory();
+}
+
+/*! \brief Check if tables of a matcher loaded from an index file are consistent
+ *
+ *  Pattern offsets must be ordered within the masks, and the outputs of
+ *  the automaton, which must have a root state if there are patterns, must
+ *  refer to existing patterns and positions in them.
+ *
+ *  \return     whether the matcher may be searched
+ */
+bool SeedSet::valid() const
+{
+    if (!automaton.valid() || (!empty() && automaton.types.size() == 0)) {
+        return false;
+    }
+    if (offsets.empty()) {
+        return masks.empty() && automaton.outputs.empty();
+    }
+    if (offsets[0] != 0 || offsets[offsets.size() - 1] != masks.size()) {
+        return false;
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+        if (offsets[i] < offsets[i - 1]) {
+            return false;
+        }
+    }
+    for (auto it = automaton.outputs.begin(); it != automaton.outputs.end(); ++it) {
+        if ((size_t)it->id + 1 >= offsets.size() || it->pos > offsets[it->id + 1] - offsets[it->id]) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef SEEDSET_H
+#define SEEDSET_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstddef>
+
+#include "search.h"
+
+/*! \brief A seed-and-verify matcher of patterns
+ *
+ *  Every pattern is split into SeedSet::errors + 1 seeds, which are disjoint
+ *  stretches of A, C, G and T bases, so a pattern occurrence with up to
+ *  SeedSet::errors errors contains at least one of its seeds unchanged.
+ *  Seeds are compiled into a flattened automaton, and each seed match is
+ *  verified against the whole pattern, where each pattern position is
+ *  represented by a mask of read bases it matches. So IUPAC codes are
+ *  supported without expanding patterns into all the sequences they stand
+ *  for.
+ *
+ *  Errors are either mismatches or, if SeedSet::edit is set, mismatches,
+ *  insertions and deletions. Edit distance verification is done by dynamic
+ *  programming in both directions from the end of a seed match.
+ */
+class SeedSet
+{
+public:
+    /*! \brief The minimum length of an anchor used for exact search
+     *
+     *  Shorter anchors would make verification too frequent.
+     */
+    static const size_t min_seed = 8;
+
+    /*! \brief Initialize an empty matcher */
+    SeedSet() : errors(0), edit(false)
+    {
+        select_kernel();
+    }
+
+    void build(std::vector <std::string> const & patterns, int errors = 0, bool edit = false);
+    void select_kernel();
+    size_t memory() const;
+    bool valid() const;
+
+    /*! \brief Search for the first pattern match in a text prefix
+     *
+     *  The search is done by the kernel specialized for the error mode of
+     *  the matcher, see select_kernel().
+     *
+     *  \param[in]  text    a text of base codes (see normalize_bases()) to
+     *                      search patterns in
+     *  \param[in]  length  the length of the text prefix to search patterns in
+     *  \param[out] costs   a buffer for edit distances, which keeps its
+     *                      capacity between calls
+     *  \return             the end position of the first match or \p length if
+     *                      no match was found
+     */
+    size_t search(const std::string & text, size_t length, std::vector <int> & costs) const
+    {
+        return (this->*kernel)(text, length, costs);
+    }
+
+    /*! \brief Check if the matcher has no patterns
+     *
+     *  \return     whether there are no patterns to search for
+     */
+    bool empty() const
+    {
+        return offsets.size() <= 1;
+    }
+
+    int errors;                         //!< the number of allowed errors
+    bool edit;                          //!< whether insertions and deletions are allowed
+    Automaton automaton;                //!< the automaton of seeds
+    Array <char> masks;                 //!< masks of read base codes matched by pattern positions
+    Array <unsigned int> offsets;       //!< offsets of patterns in SeedSet::masks
+
+private:
+    /*! \brief A search function specialized for an error mode */
+    typedef size_t (SeedSet::*Kernel)(const std::string & text, size_t length,
+                                      std::vector <int> & costs) const;
+
+    template <bool with_indels, int fixed_errors>
+    size_t search_kernel(const std::string & text, size_t length, std::vector <int> & costs) const;
+    template <bool with_indels, int fixed_errors>
+    size_t verify(const std::string & text, size_t end, size_t length,
+                  unsigned int id, size_t pos, std::vector <int> & costs) const;
+
+    Kernel kernel;                      //!< the search function selected by select_kernel()
+};
+
+size_t find_seeds(std::string const & pattern, size_t count,
+                  std::vector <std::pair <size_t, size_t> > & seeds);
+
+#endif // SEEDSET_H
@@ -15,13 +15,14 @@ std::map <ReadType, std::string> type_names;
  *  \param[in]  polyG   the minimum length of a polyG region in a read
  *  \param[in]  dust_k  this value is related to the *DustMasker* algorithm
  *  \param[in]  dust_cutoff this value is related to the *DustMasker* algorithm
+ *  \param[in]  polyA   the minimum length of a polyA region in a read
  *
  *  \remark The DustMasker algorithm is described in the following paper:
  *  Morgulis, Aleksandr, E. Michael Gertz, Alejandro A. Schäffer, and Richa
  *  Agarwala. "A fast and symmetric DUST implementation to mask low-complexity
  *  DNA sequences." *Journal of Computational Biology* 13, no. 5 (2006): 1028-1040.
  */
-void init_type_names(int length, int polyG, int dust_k, int dust_cutoff)
+void init_type_names(int length, int polyG, int dust_k, int dust_cutoff, int polyA)
 {
     type_names[ReadType::ok] = "ok";
     type_names[ReadType::adapter] = "match";
@@ -30,6 +31,8 @@ void init_type_names(int length, int polyG, int dust_k, int dust_cutoff)
     type_names[ReadType::polyC] = "polyC" + std::to_string(polyG);
     type_names[ReadType::length] = "length" + std::to_string(length);
     type_names[ReadType::dust] = "dust" + std::to_string(dust_k) + '_' + std::to_string(dust_cutoff);
+    type_names[ReadType::polyA] = "polyA" + std::to_string(polyA);
+    type_names[ReadType::polyT] = "polyT" + std::to_string(polyA);
 }
 
 /*! \brief Return a string representing a read type name
@@ -0,0 +1,160 @@
+#include "sharedindex.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*! \brief Apply or remove a lock on a file, retrying if interrupted by a signal
+ *
+ *  \param[in]  fd          the file descriptor
+ *  \param[in]  operation   the flock() operation
+ *  \return                 whether the operation succeeded
+ */
+static bool lock_file(int fd, int operation)
+{
+    int result;
+    while ((result = flock(fd, operation)) != 0 && errno == EINTR) {
+    }
+    return result == 0;
+}
+
+/*! \brief Check if a file descriptor refers to the file of a path
+ *
+ *  \param[in]  fd      the file descriptor
+ *  \param[in]  path    the file name
+ *  \return             whether the path names the open file
+ */
+static bool same_file(int fd, std::string const & path)
+{
+    struct stat opened;
+    struct stat named;
+    return fstat(fd, &opened) == 0 && stat(path.c_str(), &named) == 0 &&
+           opened.st_dev == named.st_dev && opened.st_ino == named.st_ino;
+}
+
+/*! \brief Open a lock file and lock it exclusively
+ *
+ *  The last process to detach an index removes its lock file, so a lock
+ *  taken on a removed file is dropped and the file is opened again.
+ *
+ *  \param[in]  path    the lock file name
+ *  \return             the lock file descriptor or -1 on error
+ */
+static int open_lock(std::string const & path)
+{
+    for (;;) {
+        int lock_fd = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+        if (lock_fd < 0) {
+            return -1;
+        }
+        if (!lock_file(lock_fd, LOCK_EX)) {
+            close(lock_fd);
+            return -1;
+        }
+        if (same_file(lock_fd, path)) {
+            return lock_fd;
+        }
+        close(lock_fd);
+    }
+}
+
+/*! \brief Detach the index */
+SharedIndex::~SharedIndex()
+{
+    detach();
+}
+
+/*! \brief Load a shared index, building and publishing it if it does not exist
+ *
+ *  The patterns of the library should be read before the call. If the
+ *  shared directory has no index of the library patterns and options, or its
+ *  index was built by another version, \p build is called to build the
+ *  library structures, which are then saved to the directory. The library
+ *  finally refers to the index file mapped to memory.
+ *
+ *  \param[in,out]  library     the library
+ *  \param[in]      directory   the shared directory
+ *  \param[in]      options     the options the library structures are built with
+ *  \param[in]      build       the function building the library structures
+ *  \return                     whether the index was attached
+ */
+bool SharedIndex::attach(Library & library, std::string const & directory, std::vector <int> const & options,
+                         std::function <void ()> const & build)
+{
+    uint64_t key = library.hash(options);
+    std::ostringstream name;
+    name << directory << "/cookiecutter-" << std::hex << std::setw(16) << std::setfill('0') << key;
+    path = name.str() + ".idx";
+    lock_path = name.str() + ".lock";
+
+    int lock_fd = open_lock(lock_path);
+    if (lock_fd < 0) {
+        return false;
+    }
+    bool success = true;
+    uint64_t stored;
+    if (!(Library::read_key(path, stored) && stored == key)) {
+        success = publish(library, key, build);
+    }
+    if (success) {
+        fd = open(path.c_str(), O_RDONLY);
+        success = fd >= 0 && lock_file(fd, LOCK_SH) && library.load(path) && library.key == key;
+    }
+    if (!success && fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    close(lock_fd);
+    return success;
+}
+
+/*! \brief Build library structures and save them to the shared index file
+ *
+ *  The index is written to a temporary file and renamed, so other processes
+ *  never see a partial index.
+ *
+ *  \param[in,out]  library     the library
+ *  \param[in]      key         the hash of the library patterns and options
+ *  \param[in]      build       the function building the library structures
+ *  \return                     whether the index was saved
+ */
+bool SharedIndex::publish(Library & library, uint64_t key, std::function <void ()> const & build)
+{
+    build();
+    library.key = key;
+    std::ostringstream temp;
+    temp << path << "." << getpid();
+    if (!library.save(temp.str()) || std::rename(temp.str().c_str(), path.c_str()) != 0) {
+        unlink(temp.str().c_str());
+        return false;
+    }
+    return true;
+}
+
+/*! \brief Release the index and remove it if no other process uses it
+ *
+ *  The file is only removed if it was not replaced by a newer index since
+ *  it was attached. The lock file is removed along with it while it is
+ *  still locked. The mapping of a library loaded from the index stays valid.
+ */
+void SharedIndex::detach()
+{
+    if (fd < 0) {
+        return;
+    }
+    int lock_fd = open_lock(lock_path);
+    if (lock_fd >= 0 && lock_file(fd, LOCK_EX | LOCK_NB) && same_file(fd, path)) {
+        unlink(path.c_str());
+        unlink(lock_path.c_str());
+    }
+    close(fd);
+    fd = -1;
+    if (lock_fd >= 0) {
+        close(lock_fd);
+    }
+}
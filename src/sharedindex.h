@@ -0,0 +1,46 @@
+#ifndef SHAREDINDEX_H
+#define SHAREDINDEX_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#include "library.h"
+
+/*! \brief An index shared by processes on the same node
+ *
+ *  The first process building a library with given patterns and options
+ *  saves it to an index file in a shared directory, such as /dev/shm, and
+ *  the others map the file instead of building their own copy. The file is
+ *  named after the hash of the patterns and options, which is also stored
+ *  in the index and checked along with its format version.
+ *
+ *  Each process using the index holds a shared lock on it. Attaching and
+ *  detaching are serialized by a lock file, so a process waits while
+ *  another one builds the index rather than building it too. The last
+ *  process to detach removes both the index and the lock file.
+ */
+class SharedIndex
+{
+public:
+    /*! \brief Initialize a detached index */
+    SharedIndex() : fd(-1) {}
+    ~SharedIndex();
+
+    bool attach(Library & library, std::string const & directory, std::vector <int> const & options,
+                std::function <void ()> const & build);
+    void detach();
+
+private:
+    SharedIndex(SharedIndex const &) = delete;
+    SharedIndex & operator = (SharedIndex const &) = delete;
+
+    bool publish(Library & library, uint64_t key, std::function <void ()> const & build);
+
+    std::string path;       //!< the index file
+    std::string lock_path;  //!< the lock file serializing attaching and detaching
+    int fd;                 //!< the index file descriptor holding a shared lock, -1 if detached
+};
+
+#endif // SHAREDINDEX_H
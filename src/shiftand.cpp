@@ -0,0 +1,169 @@
+#include "shiftand.h"
+#include "search.h"
+
+#include <algorithm>
+
+/*! \brief The number of read base codes a pattern position can match
+ *
+ *  The codes 0 to 4 correspond to A, C, G, T and N (see base_code()).
+ */
+static const size_t read_codes = 5;
+
+/*! \brief Get a mask of read base codes matched by a pattern character
+ *
+ *  Bits 0 to 4 of the mask correspond to read bases A, C, G, T and N. The
+ *  IUPAC code N matches any read base including N.
+ *
+ *  \param[in]  c   a pattern character in upper case
+ *  \return         the mask of matched read base codes, 0 for characters
+ *                  which are not nucleotide codes
+ */
+unsigned char iupac_mask(char c)
+{
+    enum { A = 1, C = 2, G = 4, T = 8, N = 16 };
+    switch (c) {
+    case 'A': return A;
+    case 'C': return C;
+    case 'G': return G;
+    case 'T': return T;
+    case 'R': return A | G;
+    case 'Y': return C | T;
+    case 'K': return G | T;
+    case 'M': return A | C;
+    case 'S': return C | G;
+    case 'W': return A | T;
+    case 'B': return C | G | T;
+    case 'D': return A | G | T;
+    case 'H': return A | C | T;
+    case 'V': return A | C | G;
+    case 'N': return A | C | G | T | N;
+    default: return 0;
+    }
+}
+
+/*! \brief Check if a pattern contains degenerate bases
+ *
+ *  \param[in]  pattern     a pattern in upper case
+ *  \return                 whether the pattern contains IUPAC codes other
+ *                          than A, C, G and T
+ */
+bool is_degenerate(std::string const & pattern)
+{
+    for (auto it = pattern.begin(); it != pattern.end(); ++it) {
+        unsigned char mask = iupac_mask(*it);
+        if (mask && (mask & (mask - 1))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! \brief Build the matcher from a list of patterns
+ *
+ *  Patterns which are empty or longer than ShiftAnd::max_length are skipped.
+ *
+ *  \param[in]  patterns    a list of patterns in upper case
+ */
+void ShiftAnd::build(std::vector <std::string> const & patterns)
+{
+    words = 0;
+    std::vector <uint64_t> starts;
+    std::vector <uint64_t> ends;
+    std::vector <std::vector <uint64_t> > code_masks(read_codes);
+    size_t offset = max_length;
+    for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+        if (it->empty() || it->size() > max_length) {
+            continue;
+        }
+        if (offset + it->size() > max_length) {
+            ++words;
+            offset = 0;
+            starts.push_back(0);
+            ends.push_back(0);
+            for (size_t c = 0; c < read_codes; ++c) {
+                code_masks[c].push_back(0);
+            }
+        }
+        starts.back() |= (uint64_t)1 << offset;
+        ends.back() |= (uint64_t)1 << (offset + it->size() - 1);
+        for (size_t i = 0; i < it->size(); ++i) {
+            unsigned char mask = iupac_mask((*it)[i]);
+            for (size_t c = 0; c < read_codes; ++c) {
+                if (mask & (1 << c)) {
+                    code_masks[c].back() |= (uint64_t)1 << (offset + i);
+                }
+            }
+        }
+        offset += it->size();
+    }
+    std::vector <uint64_t> masks;
+    for (size_t c = 0; c < read_codes; ++c) {
+        masks.insert(masks.end(), code_masks[c].begin(), code_masks[c].end());
+    }
+    this->masks.assign(masks);
+    this->starts.assign(starts);
+    this->ends.assign(ends);
+}
+
+/*! \brief The number of words processed together by ShiftAnd::search() */
+static const size_t block_words = 64;
+
+/*! \brief Search for the first pattern match in a text prefix
+ *
+ *  Words are processed in blocks of \ref block_words words. The text is
+ *  scanned once per block, all words of a block are updated for each text
+ *  character, and each next block is only searched for matches ending before
+ *  the first match found so far.
+ *
+ *  \param[in]  text    a text of base codes (see normalize_bases()) to search
+ *                      patterns in
+ *  \param[in]  length  the length of the text prefix to search patterns in
+ *  \return             the end position of the first match or \p length if
+ *                      no match was found
+ */
+size_t ShiftAnd::search(const std::string & text, size_t length) const
+{
+    uint64_t states[block_words];
+    for (size_t first = 0; first < words; first += block_words) {
+        size_t count = std::min(block_words, words - first);
+        const uint64_t * start = &starts[first];
+        const uint64_t * end = &ends[first];
+        std::fill(states, states + count, 0);
+        for (size_t i = 0; i < length; ++i) {
+            unsigned char c = text[i];
+            if (c >= read_codes) {
+                std::fill(states, states + count, 0);
+                continue;
+            }
+            const uint64_t * mask = &masks[c * words + first];
+            uint64_t found = 0;
+            for (size_t w = 0; w < count; ++w) {
+                states[w] = ((states[w] << 1) | start[w]) & mask[w];
+                found |= states[w] & end[w];
+            }
+            if (found) {
+                length = i;
+                break;
+            }
+        }
+    }
+    return length;
+}
+
+/*! \brief Get the size of memory allocated for the matcher
+ *
+ *  \return     the number of bytes
+ */
+size_t ShiftAnd::memory() const
+{
+    return masks.memory() + starts.memory() + ends.memory();
+}
+
+/*! \brief Check if masks of a matcher loaded from an index file are consistent
+ *
+ *  \return     whether the masks have the size given by the number of words
+ */
+bool ShiftAnd::valid() const
+{
+    return starts.size() == words && ends.size() == words && masks.size() == read_codes * words;
+}
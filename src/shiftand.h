@@ -0,0 +1,51 @@
+#ifndef SHIFTAND_H
+#define SHIFTAND_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "array.h"
+
+/*! \brief A bit-parallel matcher of patterns with degenerate bases
+ *
+ *  The class implements the Shift-And algorithm for a set of patterns. Each
+ *  pattern position is represented by a mask of read bases it matches, so
+ *  IUPAC codes are supported without expanding patterns into all the
+ *  sequences they stand for. Patterns are packed into 64-bit words; a word
+ *  holds as many whole patterns as fit in it.
+ */
+class ShiftAnd
+{
+public:
+    /*! \brief The maximum supported pattern length */
+    static const size_t max_length = 64;
+
+    /*! \brief Initialize an empty matcher */
+    ShiftAnd() : words(0) {}
+
+    void build(std::vector <std::string> const & patterns);
+    size_t search(const std::string & text, size_t length) const;
+    size_t memory() const;
+    bool valid() const;
+
+    /*! \brief Check if the matcher has no patterns
+     *
+     *  \return     whether there are no patterns to search for
+     */
+    bool empty() const
+    {
+        return words == 0;
+    }
+
+    size_t words;                   //!< the number of 64-bit words
+    Array <uint64_t> masks;         //!< masks of pattern positions matching each read base code
+    Array <uint64_t> starts;        //!< masks of the first pattern positions
+    Array <uint64_t> ends;          //!< masks of the last pattern positions
+};
+
+unsigned char iupac_mask(char c);
+bool is_degenerate(std::string const & pattern);
+
+#endif // SHIFTAND_H
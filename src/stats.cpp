@@ -1,29 +1,22 @@
 #include "stats.h"
 
-/*! \brief Update readc counts
+/*! \brief Add read counts collected separately
  *
- *  \param[in]  type    a read type
- *  \param[in]  paired  is a read paired or not
+ *  \param[in]  other   statistics on other reads of the same file
  */
-void Stats::update(ReadType type, bool paired)
+void Stats::merge(Stats const & other)
 {
-    auto it = reads.find(type);
-    if (it == reads.end()) {
-        reads[type] = 1;
-    } else {
-        ++it->second;
-    }
-    ++complete;
-    if (type == ReadType::ok) {
-        if (paired) {
-            ++pe;
-        } else {
-            ++se;
-        }
+    for (size_t i = 0; i < read_type_count; ++i) {
+        reads[i] += other.reads[i];
     }
+    complete += other.complete;
+    pe += other.pe;
+    se += other.se;
 }
 
 /*! \brief A friend function to write statistics to an output stream
+ *
+ *  Only the read types found among the processed reads are listed.
  *
  *  \param[in]  out     an output stream to write read statistics to
  *  \param[in]  stats   a Stats object to write to the specified stream
@@ -32,14 +25,18 @@ void Stats::update(ReadType type, bool paired)
 std::ostream & operator << (std::ostream & out, const Stats & stats)
 {
     out << stats.filename << std::endl;
-    unsigned int bad = 0;
-    for (auto it = stats.reads.begin(); it != stats.reads.end(); ++it) {
-        out << "\t" << get_type_name(it->first) << "\t" << it->second << std::endl;
-        if (it->first != ReadType::ok) {
-            bad += it->second;
+    uint64_t bad = 0;
+    for (size_t i = 0; i < read_type_count; ++i) {
+        if (stats.reads[i] == 0) {
+            continue;
+        }
+        out << "\t" << get_type_name((ReadType)i) << "\t" << stats.reads[i] << std::endl;
+        if (i != ReadType::ok) {
+            bad += stats.reads[i];
         }
     }
-    out << "\t" << "% passed reads\t" << (double)(stats.complete - bad)/stats.complete * 100 << "%" << std::endl;
+    double passed = stats.complete ? (double)(stats.complete - bad) / stats.complete * 100 : 0;
+    out << "\t" << "% passed reads\t" << passed << "%" << std::endl;
     if (stats.pe) {
         out << "\t" << "single-end reads\t" << stats.se << std::endl;
         out << "\t" << "paired-end reads\t" << stats.pe << std::endl;
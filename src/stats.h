@@ -1,16 +1,18 @@
 #ifndef STATS_H
 #define STATS_H
 
-#include <map>
 #include <fstream>
 #include <string>
+#include <cstdint>
 
 #include "seq.h"
 
 /*! \brief Statistics on processed reads
  *
  *  The class provides routines to collect and handle statistics on processed
- *  reads.
+ *  reads. Counts are kept in 64-bit counters indexed by read type, so reads of
+ *  a file processed in parts may be counted by separate objects which are
+ *  merged at the end.
  */
 class Stats
 {
@@ -19,17 +21,35 @@ public:
      *
      *  \param[in]  filename    a name of a file to write statistics to
      */
-    Stats(std::string const & filename) : filename(filename), complete(0), pe(0), se(0) {}
+    Stats(std::string const & filename = std::string()) : filename(filename), reads(), complete(0), pe(0), se(0) {}
 
-    void update(ReadType type, bool paired = false);
+    /*! \brief Update read counts
+     *
+     *  \param[in]  type    a read type
+     *  \param[in]  paired  is a read paired or not
+     */
+    void update(ReadType type, bool paired = false)
+    {
+        ++reads[type];
+        ++complete;
+        if (type == ReadType::ok) {
+            if (paired) {
+                ++pe;
+            } else {
+                ++se;
+            }
+        }
+    }
+
+    void merge(Stats const & other);
 
     friend std::ostream & operator << (std::ostream & out, const Stats & stats);
 
     std::string filename;   //!< the file to write statistics to
-    std::map <ReadType, unsigned int> reads;    //!< the map of read counts
-    unsigned int complete;  //!< the number of processed reads
-    unsigned int pe;        //!< the number of paired-end reads
-    unsigned int se;        //!< the number of single-end reads
+    uint64_t reads[read_type_count];    //!< the read counts by read type
+    uint64_t complete;      //!< the number of processed reads
+    uint64_t pe;            //!< the number of paired-end reads
+    uint64_t se;            //!< the number of single-end reads
 };
 
 std::ostream & operator << (std::ostream & out, const Stats & stats);
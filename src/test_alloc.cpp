@@ -0,0 +1,123 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <new>
+#include <cstdlib>
+
+#include "fastq.h"
+#include "library.h"
+#include "readroutines.h"
+#include "seq.h"
+
+/*! \brief The number of memory allocations made by the program
+ *
+ *  The replaced operator new takes memory from malloc(), which the default
+ *  operator delete releases.
+ */
+static size_t allocations = 0;
+
+void * operator new(size_t size)
+{
+    ++allocations;
+    void * p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+/*! \brief Make random reads, some of which contain a pattern
+ *
+ *  \param[in]  count       the number of reads
+ *  \param[in]  pattern     the pattern inserted into every fourth read
+ *  \param[out] seqs        the read sequences
+ */
+static void make_reads(size_t count, std::string const & pattern, std::vector <std::string> & seqs)
+{
+    static const char bases[] = "ACGT";
+    unsigned int state = 12345;
+    seqs.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string & seq = seqs[i];
+        seq.resize(60 + i % 60);
+        for (size_t j = 0; j < seq.size(); ++j) {
+            state = state * 1103515245 + 12345;
+            seq[j] = bases[(state >> 16) & 3];
+        }
+        if (i % 4 == 0) {
+            seq.replace(seq.size() / 2, pattern.size(), pattern);
+        }
+        if (i % 16 == 1) {
+            seq.replace(0, 13, std::string(13, 'G'));
+        }
+    }
+}
+
+/*! \brief Check that classifying a batch again allocates no memory
+ *
+ *  \param[in]  name        the name of the library configuration
+ *  \param[in]  library     the library
+ *  \param[in]  reads       the batch of reads
+ *  \return                 whether the second pass made no allocations
+ */
+static bool check_batch(std::string const & name, Library const & library, std::vector <FastqRecord> const & reads)
+{
+    SearchWorkspace workspace;
+    std::vector <ReadType> types;
+    check_reads(reads, reads.size(), library, 50, 4, 2, types, workspace);
+    size_t before = allocations;
+    check_reads(reads, reads.size(), library, 50, 4, 2, types, workspace);
+    size_t made = allocations - before;
+    std::cout << name << "\t" << made << " allocations" << std::endl;
+    return made == 0;
+}
+
+int main()
+{
+    std::string adapter = "AGATCGGAAGAGCACACGTCTGAACTCCAGTCAC";
+    std::vector <std::pair <std::string, Node::Type> > patterns;
+    patterns.push_back(std::make_pair(adapter, Node::Type::adapter));
+    patterns.push_back(std::make_pair("GATCGTCGGACTRTAGAA", Node::Type::adapter));
+    patterns.push_back(std::make_pair("TTACCGGCAGTAACGTTAGCTAACGGCAT", Node::Type::adapter));
+    add_special_patterns(13, 20, patterns);
+
+    std::vector <std::string> seqs;
+    make_reads(read_batch_size, adapter, seqs);
+    std::vector <FastqRecord> reads(seqs.size());
+    for (size_t i = 0; i < seqs.size(); ++i) {
+        FastqRecord record = {"@read", 5, seqs[i].data(), seqs[i].size(), seqs[i].data(), seqs[i].size()};
+        reads[i] = record;
+    }
+
+    bool success = true;
+    {
+        Library library;
+        library.patterns = patterns;
+        library.build();
+        success = check_batch("exact", library, reads) && success;
+    }
+    {
+        Library library;
+        library.patterns = patterns;
+        library.build(2, true, false, 10);
+        success = check_batch("mismatches", library, reads) && success;
+    }
+    {
+        Library library;
+        library.patterns = patterns;
+        library.build(1, false, true);
+        success = check_batch("edit distance", library, reads) && success;
+    }
+    {
+        Library library;
+        library.patterns = patterns;
+        library.build_minimizers(15, 5, 1, true, true);
+        success = check_batch("minimizers", library, reads) && success;
+    }
+
+    if (!success) {
+        std::cerr << "Reads of a batch classified again allocate memory" << std::endl;
+        return -1;
+    }
+    return 0;
+}
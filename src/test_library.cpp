@@ -0,0 +1,98 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "library.h"
+#include "search.h"
+
+/*! \brief Make a read sequence standing for a degenerate pattern
+ *
+ *  \param[in]  pattern     a pattern with IUPAC codes
+ *  \return                 the sequence taking the last base each code stands for
+ */
+static std::string instance(std::string const & pattern)
+{
+    static const std::string codes = "ACGTRYKMSWBDHVN";
+    static const std::string bases = "ACGTGTTCCTTTTGT";
+    std::string seq = pattern;
+    for (size_t i = 0; i < seq.size(); ++i) {
+        seq[i] = bases[codes.find(seq[i])];
+    }
+    return seq;
+}
+
+/*! \brief Classify a read by a library
+ *
+ *  \param[in]  library     the library
+ *  \param[in]  read        the read sequence
+ *  \return                 the match type
+ */
+static Node::Type classify(Library const & library, std::string const & read)
+{
+    SearchWorkspace workspace;
+    std::string codes;
+    normalize_bases(read, codes);
+    const std::string * texts[] = {&codes};
+    Node::Type type;
+    library.search_normalized(texts, 1, &type, workspace);
+    return type;
+}
+
+/*! \brief Check that a library classifies a read as expected
+ *
+ *  \param[in]  name        the name of the check
+ *  \param[in]  library     the library
+ *  \param[in]  read        the read sequence
+ *  \param[in]  expected    the expected match type
+ *  \return                 whether the read was classified as expected
+ */
+static bool check(std::string const & name, Library const & library, std::string const & read,
+                  Node::Type expected)
+{
+    Node::Type type = classify(library, read);
+    std::cout << name << "\t" << (type == expected ? "ok" : "failed") << std::endl;
+    return type == expected;
+}
+
+int main()
+{
+    // No stretch of A, C, G and T bases is long enough to anchor the
+    // patterns, and they are longer than a Shift-And word.
+    std::string short_runs = "ACGRTTAYGCAKTGCMAATSGCAWTGCBATGDCAHTGVCAN"
+                             "ACGRTTAYGCAKTGCMAATSGCAWTGCBATGDCAHTGVCAN";
+    std::string no_runs = std::string(40, 'R') + std::string(40, 'K');
+    std::string prefix = "TTTTTGGGGGCCCCCAAAAATTTTT";
+    std::string suffix = "GATTACAGATTACAGATTACA";
+    std::string other = prefix + std::string(90, 'C') + suffix;
+
+    bool success = true;
+    std::vector <std::pair <std::string, std::string> > patterns = {
+        std::make_pair(std::string("short anchors"), short_runs),
+        std::make_pair(std::string("no anchors"), no_runs)
+    };
+    for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+        std::string read = prefix + instance(it->second) + suffix;
+        {
+            Library library;
+            library.patterns.push_back(std::make_pair(it->second, Node::Type::adapter));
+            library.build();
+            success = check(it->first, library, read, Node::Type::adapter) && success;
+            success = check(it->first + ", no match", library, other, Node::Type::no_match) && success;
+            success = check(it->first + ", reverse strand", library, reverse_complement(read),
+                            Node::Type::no_match) && success;
+        }
+        {
+            Library library;
+            library.patterns.push_back(std::make_pair(it->second, Node::Type::adapter));
+            library.build(0, true);
+            success = check(it->first + ", both strands", library, reverse_complement(read),
+                            Node::Type::adapter) && success;
+        }
+    }
+
+    if (!success) {
+        std::cerr << "Degenerate patterns do not match reads as expected" << std::endl;
+        return -1;
+    }
+    return 0;
+}
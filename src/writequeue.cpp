@@ -0,0 +1,168 @@
+#include "writequeue.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <sys/uio.h>
+#include <unistd.h>
+
+const size_t WriteQueue::max_pending;
+
+/*! \brief The maximum number of written buffers kept for reuse */
+static const size_t max_spares = 16;
+
+/*! \brief Start the writing thread */
+WriteQueue::WriteQueue() : stopped(false)
+{
+    thread = std::thread(&WriteQueue::run, this);
+}
+
+/*! \brief Write the queued buffers and stop the thread */
+WriteQueue::~WriteQueue()
+{
+    {
+        std::lock_guard <std::mutex> lock(mutex);
+        stopped = true;
+    }
+    work.notify_all();
+    thread.join();
+}
+
+/*! \brief Get the queue shared by all writers of the program
+ *
+ *  The queue is created on first use.
+ *
+ *  \return     the queue
+ */
+WriteQueue & WriteQueue::shared()
+{
+    static WriteQueue queue;
+    return queue;
+}
+
+/*! \brief Queue a buffer for writing
+ *
+ *  \param[in]      fd      the file descriptor
+ *  \param[in,out]  data    the data to write, replaced by an empty buffer
+ *                          which may keep capacity of a written one
+ */
+void WriteQueue::write(int fd, std::string & data)
+{
+    std::unique_lock <std::mutex> lock(mutex);
+    written.wait(lock, [this, fd] { return pending[fd] < max_pending; });
+    queue.push_back(Entry());
+    queue.back().fd = fd;
+    queue.back().data.swap(data);
+    ++pending[fd];
+    if (!spares.empty()) {
+        data.swap(spares.back());
+        spares.pop_back();
+    }
+    work.notify_one();
+}
+
+/*! \brief Wait until all buffers queued for a file are written
+ *
+ *  \param[in]  fd  the file descriptor
+ *  \return         whether all data were written since the last call
+ */
+bool WriteQueue::flush(int fd)
+{
+    std::unique_lock <std::mutex> lock(mutex);
+    written.wait(lock, [this, fd] { return pending[fd] == 0; });
+    bool success = !failed[fd];
+    pending.erase(fd);
+    failed.erase(fd);
+    return success;
+}
+
+/*! \brief Write buffers to a file
+ *
+ *  \param[in]  fd      the file descriptor
+ *  \param[in]  buffers the buffers in the file order
+ *  \return             whether all data were written
+ */
+bool WriteQueue::write_buffers(int fd, std::vector <std::string *> const & buffers)
+{
+    std::vector <struct iovec> vectors;
+    for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+        if (!(*it)->empty()) {
+            struct iovec vector;
+            vector.iov_base = &(**it)[0];
+            vector.iov_len = (*it)->size();
+            vectors.push_back(vector);
+        }
+    }
+    size_t first = 0;
+    while (first < vectors.size()) {
+        ssize_t count = writev(fd, &vectors[first], vectors.size() - first);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        while (first < vectors.size() && (size_t)count >= vectors[first].iov_len) {
+            count -= vectors[first].iov_len;
+            ++first;
+        }
+        if (count > 0) {
+            vectors[first].iov_base = (char *)vectors[first].iov_base + count;
+            vectors[first].iov_len -= count;
+        }
+    }
+    return true;
+}
+
+/*! \brief Write queued buffers until the queue is destroyed
+ *
+ *  All buffers queued at once are taken together, and the buffers of each
+ *  file are written in their queue order.
+ */
+void WriteQueue::run()
+{
+    std::deque <Entry> entries;
+    std::vector <int> files;
+    std::vector <std::string *> buffers;
+    std::vector <bool> results;
+    std::unique_lock <std::mutex> lock(mutex);
+    for (;;) {
+        work.wait(lock, [this] { return stopped || !queue.empty(); });
+        if (queue.empty()) {
+            break;
+        }
+        entries.swap(queue);
+        lock.unlock();
+
+        files.clear();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (std::find(files.begin(), files.end(), it->fd) == files.end()) {
+                files.push_back(it->fd);
+            }
+        }
+        results.clear();
+        for (auto fd = files.begin(); fd != files.end(); ++fd) {
+            buffers.clear();
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if (it->fd == *fd) {
+                    buffers.push_back(&it->data);
+                }
+            }
+            results.push_back(write_buffers(*fd, buffers));
+        }
+
+        lock.lock();
+        for (size_t i = 0; i < files.size(); ++i) {
+            failed[files[i]] = failed[files[i]] || !results[i];
+        }
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            --pending[it->fd];
+            if (spares.size() < max_spares) {
+                it->data.clear();
+                spares.push_back(std::string());
+                spares.back().swap(it->data);
+            }
+        }
+        entries.clear();
+        written.notify_all();
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef WRITEQUEUE_H
+#define WRITEQUEUE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+/*! \brief A thread writing buffers to files in the background
+ *
+ *  Writers hand full buffers over to the queue and get empty ones back, so
+ *  they keep filling buffers while earlier ones are written. The thread
+ *  takes all queued buffers at once and writes the buffers of each file
+ *  with a single writev() call. The number of buffers queued for a file is
+ *  limited, so a writer waits only if the disk is slower than it.
+ */
+class WriteQueue
+{
+public:
+    /*! \brief The maximum number of buffers queued for a file */
+    static const size_t max_pending = 4;
+
+    WriteQueue();
+    ~WriteQueue();
+
+    static WriteQueue & shared();
+
+    void write(int fd, std::string & data);
+    bool flush(int fd);
+
+private:
+    /*! \brief A buffer queued for writing */
+    struct Entry
+    {
+        int fd;             //!< the file descriptor
+        std::string data;   //!< the data to write
+    };
+
+    WriteQueue(WriteQueue const &) = delete;
+    WriteQueue & operator = (WriteQueue const &) = delete;
+
+    void run();
+    static bool write_buffers(int fd, std::vector <std::string *> const & buffers);
+
+    std::deque <Entry> queue;           //!< buffers waiting to be written
+    std::vector <std::string> spares;   //!< written buffers to give back to writers
+    std::map <int, size_t> pending;     //!< the number of buffers queued or being written for each file
+    std::map <int, bool> failed;        //!< whether writing to a file failed
+    bool stopped;                       //!< whether the thread should quit
+    std::mutex mutex;                   //!< the lock of the queue
+    std::condition_variable work;       //!< notified when a buffer is queued
+    std::condition_variable written;    //!< notified when buffers are written
+    std::thread thread;                 //!< the writing thread
+};
+
+#endif // WRITEQUEUE_H